@@ -0,0 +1,119 @@
+#!/bin/sh
+# Mesure les chemins critiques de my_nm et my_db. Chaque resultat est
+# ecrit sur une ligne JSON : {"mesure": ..., "valeur": ..., "unite": ...}.
+
+set -e
+
+ICI=$(cd "$(dirname "$0")" && pwd)
+MY_NM="$ICI/../my_nm/my_nm"
+MY_DB="$ICI/../my_db/my_db"
+TRAVAIL=${BENCH_TRAVAIL:-"$ICI/travail"}
+
+NB_SYMBOLES=${BENCH_SYMBOLES:-2000000}
+NB_POINTS_ARRET=${BENCH_POINTS_ARRET:-20000}
+NB_PAS=${BENCH_PAS:-200000}
+NB_MOTS=${BENCH_MOTS:-262144}
+NB_BT=${BENCH_BT:-100}
+export BENCH_PROFONDEUR=${BENCH_PROFONDEUR:-1000}
+
+mkdir -p "$TRAVAIL"
+
+maintenant() {
+    date +%s%N
+}
+
+resultat() {
+    printf '{"mesure": "%s", "valeur": %s, "unite": "%s"}\n' "$1" "$2" "$3"
+}
+
+# Debit en unites par seconde : debit <nombre> <duree_ns>
+debit() {
+    echo $(( $1 * 1000000000 / ($2 > 0 ? $2 : 1) ))
+}
+
+# Duree en ns d'une session my_db pilotee par le fichier de commandes $2.
+# Echoue si my_db echoue ou si sa sortie ne contient pas exactement $4
+# lignes avec le motif $3 : une regression ne passe pas pour un gain.
+session() {
+    journal="$TRAVAIL/session.log"
+    debut=$(maintenant)
+    if ! "$MY_DB" "$1" < "$2" > "$journal" 2>&1; then
+        echo "bench: échec de my_db sur $2 (voir $journal)" >&2
+        exit 1
+    fi
+    fin=$(maintenant)
+    if [ -n "$3" ]; then
+        trouves=$(grep -c -- "$3" "$journal" || true)
+        if [ "$trouves" -ne "$4" ]; then
+            echo "bench: $trouves lignes \"$3\" au lieu de $4 (voir $journal)" >&2
+            exit 1
+        fi
+    fi
+    echo $(( fin - debut ))
+}
+
+# my_nm : symboles par seconde sur un objet synthetique.
+"$ICI/gen_elf" "$NB_SYMBOLES" "$TRAVAIL/symboles.o"
+debut=$(maintenant)
+"$MY_NM" "$TRAVAIL/symboles.o" > /dev/null
+fin=$(maintenant)
+resultat my_nm_symboles "$(debit "$NB_SYMBOLES" $(( fin - debut )))" "symboles/s"
+
+debut=$(maintenant)
+"$MY_NM" -C "$TRAVAIL/symboles.o" > /dev/null
+fin=$(maintenant)
+resultat my_nm_demangle "$(debit "$NB_SYMBOLES" $(( fin - debut )))" "symboles/s"
+
+debut=$(maintenant)
+"$MY_NM" --size-report "$TRAVAIL/symboles.o" > /dev/null
+fin=$(maintenant)
+resultat my_nm_rapport_taille "$(debit "$NB_SYMBOLES" $(( fin - debut )))" \
+    "symboles/s"
+
+# Cout du lancement et de l'arret de my_db, retire des mesures suivantes.
+echo q > "$TRAVAIL/vide.cmd"
+base=$(session "$ICI/boucle" "$TRAVAIL/vide.cmd")
+
+# Points d'arret : un passage par continue.
+{
+    echo "b fonction_chaude"
+    i=0
+    while [ "$i" -lt "$NB_POINTS_ARRET" ]; do
+        echo c
+        i=$((i + 1))
+    done
+    echo q
+} > "$TRAVAIL/points_arret.cmd"
+duree=$(session "$ICI/boucle" "$TRAVAIL/points_arret.cmd" \
+    "Breakpoint at" "$NB_POINTS_ARRET")
+resultat my_db_points_arret "$(debit "$NB_POINTS_ARRET" $(( duree - base )))" \
+    "passages/s"
+
+# Pas a pas.
+printf 'n %s\nq\n' "$NB_PAS" > "$TRAVAIL/pas.cmd"
+duree=$(session "$ICI/boucle" "$TRAVAIL/pas.cmd" "Programme arrêté à" \
+    "$NB_PAS")
+resultat my_db_pas "$(debit "$NB_PAS" $(( duree - base )))" "pas/s"
+
+# Lecture memoire avec x sur le tableau donnees.
+adresse=$("$MY_NM" "$ICI/boucle" | awk '$7 == "donnees" { print "0x" $1 }')
+printf 'x %s %s\nq\n' "$NB_MOTS" "$adresse" > "$TRAVAIL/memoire.cmd"
+duree=$(session "$ICI/boucle" "$TRAVAIL/memoire.cmd" ": 0x" "$NB_MOTS")
+resultat my_db_lecture_memoire \
+    "$(debit $(( NB_MOTS * 8 )) $(( duree - base )))" "octets/s"
+
+# Latence de bt a la profondeur BENCH_PROFONDEUR.
+printf 'b fond\nc\nq\n' > "$TRAVAIL/bt_base.cmd"
+{
+    echo "b fond"
+    echo c
+    i=0
+    while [ "$i" -lt "$NB_BT" ]; do
+        echo bt
+        i=$((i + 1))
+    done
+    echo q
+} > "$TRAVAIL/bt.cmd"
+base_bt=$(session "$ICI/recursion" "$TRAVAIL/bt_base.cmd" "Breakpoint at" 1)
+duree=$(session "$ICI/recursion" "$TRAVAIL/bt.cmd" "#0 " "$NB_BT")
+resultat my_db_bt_latence $(( (duree - base_bt) / NB_BT / 1000 )) "us"
@@ -0,0 +1,28 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Cible des mesures de points d'arret, de pas a pas et de lecture
+ * memoire : appelle fonction_chaude en boucle. */
+
+#define TAILLE_DONNEES (2 * 1024 * 1024)
+
+unsigned char donnees[TAILLE_DONNEES];
+volatile unsigned long total;
+
+void fonction_chaude(unsigned long i)
+{
+    total += i ^ donnees[i % TAILLE_DONNEES];
+}
+
+int main(void)
+{
+    const char *env = getenv("BENCH_ITERATIONS");
+    unsigned long iterations = env ? strtoul(env, NULL, 0) : 100000000UL;
+
+    for (unsigned long i = 0; i < TAILLE_DONNEES; i++)
+        donnees[i] = (unsigned char)i;
+    for (unsigned long i = 0; i < iterations; i++)
+        fonction_chaude(i);
+    printf("%lu\n", total);
+    return 0;
+}
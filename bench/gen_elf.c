@@ -0,0 +1,181 @@
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Genere un objet ELF64 relogeable contenant un grand nombre de symboles
+ * repartis entre .text et .data, pour mesurer my_nm. */
+
+enum
+{
+    SEC_NULL,
+    SEC_TEXT,
+    SEC_DATA,
+    SEC_SYMTAB,
+    SEC_STRTAB,
+    SEC_SHSTRTAB,
+    NB_SECTIONS
+};
+
+static const char noms_sections[] =
+    "\0.text\0.data\0.symtab\0.strtab\0.shstrtab";
+
+static void nom_symbole(char *tampon, size_t taille, size_t i)
+{
+    /* Un tiers de noms C++ ranges par espace de noms, le reste en C. */
+    if (i % 3 == 0)
+    {
+        /* La longueur du nom source suit le nombre de chiffres de i. */
+        char fonction[32];
+        int longueur = snprintf(fonction, sizeof(fonction), "fn%07zu", i);
+        snprintf(tampon, taille, "_ZN5mod%02zu%d%sEv", i % 97, longueur,
+                 fonction);
+    }
+    else if (i % 3 == 1)
+        snprintf(tampon, taille, "mod%02zu_fonction_%zu", i % 97, i);
+    else
+        snprintf(tampon, taille, "donnee_%zu", i);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s <nombre_symboles> <sortie>\n", argv[0]);
+        return 1;
+    }
+
+    size_t nb_symboles = strtoul(argv[1], NULL, 0);
+    FILE *sortie = fopen(argv[2], "wb");
+    if (!sortie)
+    {
+        perror("fopen");
+        return 1;
+    }
+
+    Elf64_Sym *symboles = calloc(nb_symboles + 1, sizeof(Elf64_Sym));
+    size_t capacite_chaines = 1 + nb_symboles * 24;
+    char *chaines = malloc(capacite_chaines);
+    if (!symboles || !chaines)
+    {
+        fprintf(stderr, "Mémoire insuffisante\n");
+        return 1;
+    }
+
+    size_t taille_chaines = 1;
+    chaines[0] = '\0';
+    Elf64_Addr texte = 0;
+    Elf64_Addr donnees = 0;
+    for (size_t i = 0; i < nb_symboles; i++)
+    {
+        Elf64_Sym *sym = &symboles[i + 1];
+        char nom[64];
+        nom_symbole(nom, sizeof(nom), i);
+        size_t longueur = strlen(nom) + 1;
+        if (taille_chaines + longueur > capacite_chaines)
+        {
+            capacite_chaines *= 2;
+            chaines = realloc(chaines, capacite_chaines);
+            if (!chaines)
+            {
+                fprintf(stderr, "Mémoire insuffisante\n");
+                return 1;
+            }
+        }
+        memcpy(chaines + taille_chaines, nom, longueur);
+        sym->st_name = (Elf64_Word)taille_chaines;
+        taille_chaines += longueur;
+
+        sym->st_size = (i * 2654435761u) % 256 + 1;
+        if (i % 3 == 2)
+        {
+            sym->st_info = ELF64_ST_INFO(STB_GLOBAL, STT_OBJECT);
+            sym->st_shndx = SEC_DATA;
+            sym->st_value = donnees;
+            donnees += (sym->st_size + 7) & ~7UL;
+        }
+        else
+        {
+            sym->st_info = ELF64_ST_INFO(i % 5 ? STB_GLOBAL : STB_LOCAL,
+                                         STT_FUNC);
+            sym->st_shndx = SEC_TEXT;
+            sym->st_value = texte;
+            texte += (sym->st_size + 15) & ~15UL;
+        }
+    }
+
+    Elf64_Shdr sections[NB_SECTIONS];
+    memset(sections, 0, sizeof(sections));
+    size_t taille_symtab = (nb_symboles + 1) * sizeof(Elf64_Sym);
+    Elf64_Off position = sizeof(Elf64_Ehdr);
+
+    sections[SEC_TEXT].sh_name = 1;
+    sections[SEC_TEXT].sh_type = SHT_NOBITS;
+    sections[SEC_TEXT].sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+    sections[SEC_TEXT].sh_size = texte;
+    sections[SEC_TEXT].sh_addralign = 16;
+
+    sections[SEC_DATA].sh_name = 7;
+    sections[SEC_DATA].sh_type = SHT_NOBITS;
+    sections[SEC_DATA].sh_flags = SHF_ALLOC | SHF_WRITE;
+    sections[SEC_DATA].sh_size = donnees;
+    sections[SEC_DATA].sh_addralign = 8;
+
+    sections[SEC_SYMTAB].sh_name = 13;
+    sections[SEC_SYMTAB].sh_type = SHT_SYMTAB;
+    sections[SEC_SYMTAB].sh_offset = position;
+    sections[SEC_SYMTAB].sh_size = taille_symtab;
+    sections[SEC_SYMTAB].sh_link = SEC_STRTAB;
+    sections[SEC_SYMTAB].sh_info = 1;
+    sections[SEC_SYMTAB].sh_addralign = 8;
+    sections[SEC_SYMTAB].sh_entsize = sizeof(Elf64_Sym);
+    position += taille_symtab;
+
+    sections[SEC_STRTAB].sh_name = 21;
+    sections[SEC_STRTAB].sh_type = SHT_STRTAB;
+    sections[SEC_STRTAB].sh_offset = position;
+    sections[SEC_STRTAB].sh_size = taille_chaines;
+    sections[SEC_STRTAB].sh_addralign = 1;
+    position += taille_chaines;
+
+    sections[SEC_SHSTRTAB].sh_name = 29;
+    sections[SEC_SHSTRTAB].sh_type = SHT_STRTAB;
+    sections[SEC_SHSTRTAB].sh_offset = position;
+    sections[SEC_SHSTRTAB].sh_size = sizeof(noms_sections);
+    sections[SEC_SHSTRTAB].sh_addralign = 1;
+    position += sizeof(noms_sections);
+    position = (position + 7) & ~7UL;
+
+    Elf64_Ehdr entete;
+    memset(&entete, 0, sizeof(entete));
+    memcpy(entete.e_ident, ELFMAG, SELFMAG);
+    entete.e_ident[EI_CLASS] = ELFCLASS64;
+    entete.e_ident[EI_DATA] = ELFDATA2LSB;
+    entete.e_ident[EI_VERSION] = EV_CURRENT;
+    entete.e_type = ET_REL;
+    entete.e_machine = EM_X86_64;
+    entete.e_version = EV_CURRENT;
+    entete.e_shoff = position;
+    entete.e_ehsize = sizeof(Elf64_Ehdr);
+    entete.e_shentsize = sizeof(Elf64_Shdr);
+    entete.e_shnum = NB_SECTIONS;
+    entete.e_shstrndx = SEC_SHSTRTAB;
+
+    static const char bourrage[8];
+    size_t fin = sections[SEC_SHSTRTAB].sh_offset + sizeof(noms_sections);
+    fwrite(&entete, sizeof(entete), 1, sortie);
+    fwrite(symboles, sizeof(Elf64_Sym), nb_symboles + 1, sortie);
+    fwrite(chaines, 1, taille_chaines, sortie);
+    fwrite(noms_sections, 1, sizeof(noms_sections), sortie);
+    fwrite(bourrage, 1, position - fin, sortie);
+    fwrite(sections, sizeof(Elf64_Shdr), NB_SECTIONS, sortie);
+
+    free(symboles);
+    free(chaines);
+    if (fclose(sortie) != 0)
+    {
+        perror("fclose");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,31 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Cible de la mesure de bt : descend a une profondeur donnee avant
+ * d'appeler fond. */
+
+volatile int resultat;
+
+void fond(void)
+{
+    resultat++;
+}
+
+int descendre(int profondeur)
+{
+    if (profondeur == 0)
+    {
+        fond();
+        return resultat;
+    }
+    return descendre(profondeur - 1) + 1;
+}
+
+int main(void)
+{
+    const char *env = getenv("BENCH_PROFONDEUR");
+    int profondeur = env ? atoi(env) : 1000;
+
+    printf("%d\n", descendre(profondeur));
+    return 0;
+}
@@ -0,0 +1,1617 @@
+#include "demangleur.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TAILLE_BLOC_ARENE 65536
+#define MAX_SUBSTITUTIONS 512
+#define MAX_PARAMETRES 64
+#define MAX_RECURSION 256
+
+struct bloc_arene
+{
+    struct bloc_arene *suivant;
+    size_t taille;
+    size_t utilise;
+    char donnees[];
+};
+
+void *arene_allouer(struct arene *arene, size_t taille)
+{
+    taille = (taille + 7) & ~(size_t)7;
+
+    struct bloc_arene *bloc = arene->bloc;
+    if (bloc == NULL || bloc->taille - bloc->utilise < taille)
+    {
+        size_t capacite = taille > TAILLE_BLOC_ARENE ? taille
+                                                     : TAILLE_BLOC_ARENE;
+        bloc = malloc(sizeof(struct bloc_arene) + capacite);
+        if (bloc == NULL)
+            return NULL;
+        bloc->suivant = arene->bloc;
+        bloc->taille = capacite;
+        bloc->utilise = 0;
+        arene->bloc = bloc;
+    }
+
+    void *resultat = bloc->donnees + bloc->utilise;
+    bloc->utilise += taille;
+    return resultat;
+}
+
+char *arene_copier(struct arene *arene, const char *texte)
+{
+    size_t taille = strlen(texte) + 1;
+    char *copie = arene_allouer(arene, taille);
+    if (copie != NULL)
+        memcpy(copie, texte, taille);
+    return copie;
+}
+
+/* Garde le bloc courant pour eviter un malloc par nom demangle. */
+void arene_vider(struct arene *arene)
+{
+    struct bloc_arene *bloc = arene->bloc;
+    if (bloc == NULL)
+        return;
+
+    struct bloc_arene *suivant = bloc->suivant;
+    while (suivant != NULL)
+    {
+        struct bloc_arene *a_liberer = suivant;
+        suivant = suivant->suivant;
+        free(a_liberer);
+    }
+    bloc->suivant = NULL;
+    bloc->utilise = 0;
+}
+
+void arene_liberer(struct arene *arene)
+{
+    while (arene->bloc != NULL)
+    {
+        struct bloc_arene *suivant = arene->bloc->suivant;
+        free(arene->bloc);
+        arene->bloc = suivant;
+    }
+}
+
+/* Un type se rend en "gauche" + "droite" : la partie droite porte les
+   parametres d'une fonction ou les dimensions d'un tableau, pour que
+   les pointeurs s'inserent au milieu ("void (*)(int)"). */
+struct type_dem
+{
+    const char *gauche;
+    const char *droite;
+    int parenthese;
+    int tableau;
+};
+
+/* Argument de modele : son type est garde pour que T_ se substitue en
+   conservant gauche et droite ("char (&) [4]"). Un paquet (J...E)
+   garde aussi ses elements pour les expansions "Dp". */
+struct parametre
+{
+    const char *texte;
+    struct type_dem type;
+    struct type_dem *elements;
+    int nb_elements;
+};
+
+struct etat
+{
+    const char *p;
+    struct arene *arene;
+    struct type_dem substitutions[MAX_SUBSTITUTIONS];
+    int nb_substitutions;
+    struct parametre parametres[MAX_PARAMETRES];
+    int nb_parametres;
+    int profondeur_type;
+    int recursion;
+    int dans_expansion;
+    int indice_paquet;
+    struct parametre *paquet;
+};
+
+struct info_nom
+{
+    int modele;
+    int special;
+    const char *qualificatifs;
+};
+
+struct operateur
+{
+    const char *code;
+    const char *nom;
+};
+
+static const struct operateur operateurs[] = {
+    { "nw", "new" },  { "na", "new[]" }, { "dl", "delete" },
+    { "da", "delete[]" }, { "ps", "+" }, { "ng", "-" },
+    { "ad", "&" },    { "de", "*" },     { "co", "~" },
+    { "pl", "+" },    { "mi", "-" },     { "ml", "*" },
+    { "dv", "/" },    { "rm", "%" },     { "an", "&" },
+    { "or", "|" },    { "eo", "^" },     { "aS", "=" },
+    { "pL", "+=" },   { "mI", "-=" },    { "mL", "*=" },
+    { "dV", "/=" },   { "rM", "%=" },    { "aN", "&=" },
+    { "oR", "|=" },   { "eO", "^=" },    { "ls", "<<" },
+    { "rs", ">>" },   { "lS", "<<=" },   { "rS", ">>=" },
+    { "eq", "==" },   { "ne", "!=" },    { "lt", "<" },
+    { "gt", ">" },    { "le", "<=" },    { "ge", ">=" },
+    { "ss", "<=>" },  { "nt", "!" },     { "aa", "&&" },
+    { "oo", "||" },   { "pp", "++" },    { "mm", "--" },
+    { "cm", "," },    { "pm", "->*" },   { "pt", "->" },
+    { "cl", "()" },   { "ix", "[]" },    { "qu", "?" },
+};
+
+static const char *types_simples[26] = {
+    ['a' - 'a'] = "signed char",   ['b' - 'a'] = "bool",
+    ['c' - 'a'] = "char",          ['d' - 'a'] = "double",
+    ['e' - 'a'] = "long double",   ['f' - 'a'] = "float",
+    ['g' - 'a'] = "__float128",    ['h' - 'a'] = "unsigned char",
+    ['i' - 'a'] = "int",           ['j' - 'a'] = "unsigned int",
+    ['l' - 'a'] = "long",          ['m' - 'a'] = "unsigned long",
+    ['n' - 'a'] = "__int128",      ['o' - 'a'] = "unsigned __int128",
+    ['s' - 'a'] = "short",         ['t' - 'a'] = "unsigned short",
+    ['v' - 'a'] = "void",          ['w' - 'a'] = "wchar_t",
+    ['x' - 'a'] = "long long",     ['y' - 'a'] = "unsigned long long",
+    ['z' - 'a'] = "...",
+};
+
+static int lire_type(struct etat *e, struct type_dem *type);
+static const char *lire_nom(struct etat *e, struct info_nom *info);
+static const char *lire_encodage(struct etat *e, int avec_retour);
+
+static const char *concatener(struct etat *e, const char *a, const char *b,
+                              const char *c)
+{
+    size_t la = strlen(a);
+    size_t lb = strlen(b);
+    size_t lc = strlen(c);
+    char *resultat = arene_allouer(e->arene, la + lb + lc + 1);
+    if (resultat == NULL)
+        return NULL;
+
+    memcpy(resultat, a, la);
+    memcpy(resultat + la, b, lb);
+    memcpy(resultat + la + lb, c, lc + 1);
+    return resultat;
+}
+
+static const char *copier_morceau(struct etat *e, const char *debut,
+                                  size_t taille)
+{
+    char *resultat = arene_allouer(e->arene, taille + 1);
+    if (resultat == NULL)
+        return NULL;
+
+    memcpy(resultat, debut, taille);
+    resultat[taille] = '\0';
+    return resultat;
+}
+
+static struct type_dem type_simple(const char *texte)
+{
+    struct type_dem type = { texte, "", 0, 0 };
+    return type;
+}
+
+static const char *rendre(struct etat *e, struct type_dem *type)
+{
+    if (type->droite[0] == '\0')
+        return type->gauche;
+    return concatener(e, type->gauche, type->droite, "");
+}
+
+static void ajouter_substitution(struct etat *e, struct type_dem *type)
+{
+    if (e->nb_substitutions < MAX_SUBSTITUTIONS)
+        e->substitutions[e->nb_substitutions++] = *type;
+}
+
+static void ajouter_substitution_nom(struct etat *e, const char *nom)
+{
+    struct type_dem type = type_simple(nom);
+    ajouter_substitution(e, &type);
+}
+
+/* Nombre decimal ; -1 s'il n'y a pas de chiffre. */
+static long lire_nombre(struct etat *e)
+{
+    if (!isdigit((unsigned char)*e->p))
+        return -1;
+
+    long valeur = 0;
+    while (isdigit((unsigned char)*e->p))
+    {
+        valeur = valeur * 10 + (*e->p - '0');
+        if (valeur > 1000000)
+            return -1;
+        e->p++;
+    }
+    return valeur;
+}
+
+/* Numero de sequence "[<base 36>]_" : 0 pour "_", n + 1 sinon. */
+static long lire_sequence(struct etat *e)
+{
+    long valeur = 0;
+    if (*e->p == '_')
+    {
+        e->p++;
+        return 0;
+    }
+
+    while (isdigit((unsigned char)*e->p) || isupper((unsigned char)*e->p))
+    {
+        int chiffre = isdigit((unsigned char)*e->p) ? *e->p - '0'
+                                                     : *e->p - 'A' + 10;
+        valeur = valeur * 36 + chiffre;
+        if (valeur > 1000000)
+            return -1;
+        e->p++;
+    }
+
+    if (*e->p != '_')
+        return -1;
+    e->p++;
+    return valeur + 1;
+}
+
+static const char *lire_nom_source(struct etat *e)
+{
+    long taille = lire_nombre(e);
+    if (taille <= 0)
+        return NULL;
+
+    for (long i = 0; i < taille; i++)
+        if (e->p[i] == '\0')
+            return NULL;
+
+    const char *debut = e->p;
+    e->p += taille;
+
+    if (taille >= 10 && strncmp(debut, "_GLOBAL__N", 10) == 0)
+        return "(anonymous namespace)";
+    return copier_morceau(e, debut, (size_t)taille);
+}
+
+/* Dernier composant d'un nom qualifie, sans arguments de modele, pour
+   nommer constructeurs et destructeurs. */
+static const char *nom_de_base(struct etat *e, const char *nom)
+{
+    if (nom == NULL)
+        return NULL;
+
+    const char *debut = nom;
+    int niveau = 0;
+    for (const char *c = nom; *c; c++)
+    {
+        if (*c == '<')
+            niveau++;
+        else if (*c == '>')
+            niveau--;
+        else if (niveau == 0 && c[0] == ':' && c[1] == ':')
+            debut = c + 2;
+    }
+
+    size_t taille = strcspn(debut, "<[");
+    return copier_morceau(e, debut, taille);
+}
+
+static const char *lire_substitution(struct etat *e)
+{
+    e->p++;
+    switch (*e->p)
+    {
+    case 'a':
+        e->p++;
+        return "std::allocator";
+    case 'b':
+        e->p++;
+        return "std::basic_string";
+    case 's':
+        e->p++;
+        return "std::basic_string<char, std::char_traits<char>, "
+               "std::allocator<char> >";
+    case 'i':
+        e->p++;
+        return "std::basic_istream<char, std::char_traits<char> >";
+    case 'o':
+        e->p++;
+        return "std::basic_ostream<char, std::char_traits<char> >";
+    case 'd':
+        e->p++;
+        return "std::basic_iostream<char, std::char_traits<char> >";
+    default:
+        break;
+    }
+
+    long indice = lire_sequence(e);
+    if (indice < 0 || indice >= e->nb_substitutions)
+        return NULL;
+    return rendre(e, &e->substitutions[indice]);
+}
+
+static int lire_parametre_modele(struct etat *e, struct type_dem *type)
+{
+    e->p++;
+    long indice = lire_sequence(e);
+    if (indice < 0 || indice >= e->nb_parametres)
+        return -1;
+
+    struct parametre *parametre = &e->parametres[indice];
+    if (!e->dans_expansion || parametre->nb_elements < 0)
+        *type = parametre->type;
+    else
+    {
+        e->paquet = parametre;
+        if (e->indice_paquet >= parametre->nb_elements)
+            *type = type_simple("");
+        else
+            *type = parametre->elements[e->indice_paquet];
+    }
+    return 0;
+}
+
+static const char *texte_parametre_modele(struct etat *e)
+{
+    struct type_dem type;
+    if (lire_parametre_modele(e, &type) != 0)
+        return NULL;
+    return rendre(e, &type);
+}
+
+/* Valeur d'un litteral "L <type> <valeur> E", au format de c++filt. */
+static const char *lire_litteral(struct etat *e)
+{
+    e->p++;
+    if (e->p[0] == '_' && e->p[1] == 'Z')
+    {
+        e->p += 2;
+        const char *nom = lire_encodage(e, 1);
+        if (nom == NULL || *e->p != 'E')
+            return NULL;
+        e->p++;
+        return nom;
+    }
+
+    struct type_dem type;
+    if (lire_type(e, &type) != 0)
+        return NULL;
+    const char *nom_type = rendre(e, &type);
+    if (nom_type == NULL)
+        return NULL;
+
+    const char *signe = "";
+    if (*e->p == 'n')
+    {
+        signe = "-";
+        e->p++;
+    }
+
+    const char *debut = e->p;
+    while (*e->p != 'E' && *e->p != '\0')
+        e->p++;
+    if (*e->p != 'E' || e->p == debut)
+        return NULL;
+    const char *valeur = copier_morceau(e, debut, (size_t)(e->p - debut));
+    e->p++;
+    if (valeur == NULL)
+        return NULL;
+
+    if (strcmp(nom_type, "bool") == 0)
+        return strcmp(valeur, "0") == 0 ? "false" : "true";
+    if (strcmp(nom_type, "int") == 0)
+        return concatener(e, signe, valeur, "");
+
+    static const struct operateur suffixes[] = {
+        { "unsigned int", "u" }, { "long", "l" },
+        { "unsigned long", "ul" }, { "long long", "ll" },
+        { "unsigned long long", "ull" },
+    };
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++)
+        if (strcmp(nom_type, suffixes[i].code) == 0)
+            return concatener(e, signe, valeur, suffixes[i].nom);
+
+    const char *prefixe = concatener(e, "(", nom_type, ")");
+    if (prefixe == NULL)
+        return NULL;
+    return concatener(e, prefixe, signe, valeur);
+}
+
+/* Un paquet vide ne laisse pas de ", " orphelin. */
+static const char *ajouter_argument(struct etat *e, const char *liste,
+                                    const char *argument)
+{
+    if (argument[0] == '\0')
+        return liste;
+    if (liste[0] == '\0')
+        return argument;
+    return concatener(e, liste, ", ", argument);
+}
+
+static int lire_argument_modele(struct etat *e, struct parametre *argument);
+
+/* Arguments jusqu'a 'E' ; les paquets gardent leurs elements. */
+static int lire_liste_arguments(struct etat *e, struct parametre *liste)
+{
+    struct type_dem elements[MAX_PARAMETRES];
+    int nb_elements = 0;
+    const char *texte = "";
+
+    e->p++;
+    while (*e->p != 'E')
+    {
+        struct parametre argument;
+        if (lire_argument_modele(e, &argument) != 0)
+            return -1;
+        if (nb_elements < MAX_PARAMETRES)
+            elements[nb_elements++] = argument.type;
+        texte = ajouter_argument(e, texte, argument.texte);
+        if (texte == NULL)
+            return -1;
+    }
+    e->p++;
+
+    liste->texte = texte;
+    liste->type = type_simple(texte);
+    liste->nb_elements = nb_elements;
+    liste->elements = arene_allouer(
+        e->arene, (size_t)(nb_elements + 1) * sizeof(elements[0]));
+    if (liste->elements == NULL)
+        return -1;
+    memcpy(liste->elements, elements,
+           (size_t)nb_elements * sizeof(elements[0]));
+    return 0;
+}
+
+static const char *lire_arguments_modele(struct etat *e)
+{
+    struct parametre arguments[MAX_PARAMETRES];
+    int nb_arguments = 0;
+    const char *liste = "";
+
+    e->p++;
+    while (*e->p != 'E')
+    {
+        struct parametre argument;
+        if (lire_argument_modele(e, &argument) != 0)
+            return NULL;
+        if (nb_arguments < MAX_PARAMETRES)
+            arguments[nb_arguments++] = argument;
+        liste = ajouter_argument(e, liste, argument.texte);
+        if (liste == NULL)
+            return NULL;
+    }
+    e->p++;
+
+    /* Seuls les arguments du nom de l'entite servent aux T_ qui
+       suivent (type de retour et parametres). */
+    if (e->profondeur_type == 0)
+    {
+        memcpy(e->parametres, arguments,
+               (size_t)nb_arguments * sizeof(arguments[0]));
+        e->nb_parametres = nb_arguments;
+    }
+
+    size_t taille = strlen(liste);
+    if (taille > 0 && liste[taille - 1] == '>')
+        return concatener(e, "<", liste, " >");
+    return concatener(e, "<", liste, ">");
+}
+
+static int lire_argument_modele(struct etat *e, struct parametre *argument)
+{
+    argument->elements = NULL;
+    argument->nb_elements = -1;
+
+    /* "I...E" est l'ancien encodage des paquets de GCC. */
+    if (*e->p == 'J' || *e->p == 'I')
+        return lire_liste_arguments(e, argument);
+
+    if (*e->p == 'L')
+    {
+        argument->texte = lire_litteral(e);
+        argument->type = type_simple(argument->texte);
+        return argument->texte ? 0 : -1;
+    }
+
+    /* Seules les expressions reduites a un parametre ou un litteral
+       sont gerees. */
+    if (*e->p == 'X')
+    {
+        e->p++;
+        if (*e->p == 'T')
+            argument->texte = texte_parametre_modele(e);
+        else if (*e->p == 'L')
+            argument->texte = lire_litteral(e);
+        else
+            return -1;
+        if (argument->texte == NULL || *e->p != 'E')
+            return -1;
+        e->p++;
+        argument->type = type_simple(argument->texte);
+        return 0;
+    }
+
+    struct type_dem type;
+    e->profondeur_type++;
+    int resultat = lire_type(e, &type);
+    e->profondeur_type--;
+    if (resultat != 0)
+        return -1;
+    argument->type = type;
+    argument->texte = rendre(e, &type);
+    return argument->texte ? 0 : -1;
+}
+
+/* Liste de parametres jusqu'a 'E', '.' ou la fin ; "v" seul = "()". */
+static const char *lire_parametres(struct etat *e)
+{
+    const char *liste = "";
+    int nb = 0;
+    int vide = 0;
+
+    while (*e->p != 'E' && *e->p != '.' && *e->p != '\0')
+    {
+        if (nb == 0 && e->p[0] == 'v'
+            && (e->p[1] == 'E' || e->p[1] == '.' || e->p[1] == '\0'))
+        {
+            e->p++;
+            vide = 1;
+            break;
+        }
+
+        struct type_dem type;
+        e->profondeur_type++;
+        int resultat = lire_type(e, &type);
+        e->profondeur_type--;
+        if (resultat != 0)
+            return NULL;
+
+        const char *texte = rendre(e, &type);
+        if (texte == NULL)
+            return NULL;
+        nb++;
+        if (texte[0] == '\0')
+        {
+            vide = 1;
+            continue;
+        }
+        liste = ajouter_argument(e, liste, texte);
+        if (liste == NULL)
+            return NULL;
+    }
+
+    if (nb == 0 && !vide)
+        return NULL;
+    return concatener(e, "(", liste, ")");
+}
+
+static const char *lire_operateur(struct etat *e, struct info_nom *info)
+{
+    if (e->p[0] == 'c' && e->p[1] == 'v')
+    {
+        struct type_dem type;
+        e->p += 2;
+        e->profondeur_type++;
+        int resultat = lire_type(e, &type);
+        e->profondeur_type--;
+        if (resultat != 0)
+            return NULL;
+        info->special = 1;
+        const char *texte = rendre(e, &type);
+        return texte ? concatener(e, "operator ", texte, "") : NULL;
+    }
+
+    if (e->p[0] == 'l' && e->p[1] == 'i')
+    {
+        e->p += 2;
+        const char *nom = lire_nom_source(e);
+        return nom ? concatener(e, "operator\"\" ", nom, "") : NULL;
+    }
+
+    for (size_t i = 0; i < sizeof(operateurs) / sizeof(operateurs[0]); i++)
+    {
+        if (e->p[0] == operateurs[i].code[0]
+            && e->p[1] == operateurs[i].code[1])
+        {
+            e->p += 2;
+            const char *nom = operateurs[i].nom;
+            if (isalpha((unsigned char)nom[0]))
+                return concatener(e, "operator ", nom, "");
+            return concatener(e, "operator", nom, "");
+        }
+    }
+    return NULL;
+}
+
+/* "{unnamed type#N}" ou "{lambda(params)#N}". */
+static const char *lire_type_anonyme(struct etat *e)
+{
+    const char *texte;
+    if (e->p[1] == 't')
+    {
+        e->p += 2;
+        texte = "{unnamed type#";
+    }
+    else if (e->p[1] == 'l')
+    {
+        e->p += 2;
+        const char *parametres = lire_parametres(e);
+        if (parametres == NULL || *e->p != 'E')
+            return NULL;
+        e->p++;
+        texte = concatener(e, "{lambda", parametres, "#");
+        if (texte == NULL)
+            return NULL;
+    }
+    else
+        return NULL;
+
+    long numero = 1;
+    if (*e->p != '_')
+    {
+        numero = lire_nombre(e);
+        if (numero < 0)
+            return NULL;
+        numero += 2;
+    }
+    if (*e->p != '_')
+        return NULL;
+    e->p++;
+
+    char chiffres[24];
+    int n = 0;
+    do
+    {
+        chiffres[n++] = (char)('0' + numero % 10);
+        numero /= 10;
+    } while (numero > 0);
+
+    char nombre[24];
+    for (int i = 0; i < n; i++)
+        nombre[i] = chiffres[n - 1 - i];
+    nombre[n] = '\0';
+
+    return concatener(e, texte, nombre, "}");
+}
+
+static const char *lire_nom_non_qualifie(struct etat *e, const char *prefixe,
+                                         struct info_nom *info)
+{
+    const char *nom;
+    info->special = 0;
+
+    if (*e->p == 'L')
+        e->p++;
+
+    if (isdigit((unsigned char)*e->p))
+        nom = lire_nom_source(e);
+    else if (*e->p == 'C' && (e->p[1] == 'I' || isdigit((unsigned char)e->p[1])))
+    {
+        e->p += e->p[1] == 'I' ? 3 : 2;
+        if (e->p[-2] == 'I')
+        {
+            struct type_dem type;
+            if (lire_type(e, &type) != 0)
+                return NULL;
+        }
+        nom = nom_de_base(e, prefixe);
+        info->special = 1;
+    }
+    else if (*e->p == 'D' && e->p[1] >= '0' && e->p[1] <= '5')
+    {
+        e->p += 2;
+        const char *base = nom_de_base(e, prefixe);
+        nom = base ? concatener(e, "~", base, "") : NULL;
+        info->special = 1;
+    }
+    else if (*e->p == 'U')
+        nom = lire_type_anonyme(e);
+    else if (islower((unsigned char)*e->p))
+        nom = lire_operateur(e, info);
+    else
+        return NULL;
+
+    while (nom != NULL && *e->p == 'B')
+    {
+        e->p++;
+        const char *etiquette = lire_nom_source(e);
+        if (etiquette == NULL)
+            return NULL;
+        const char *suffixe = concatener(e, "[abi:", etiquette, "]");
+        nom = suffixe ? concatener(e, nom, suffixe, "") : NULL;
+    }
+    return nom;
+}
+
+static const char *joindre(struct etat *e, const char *prefixe,
+                           const char *nom)
+{
+    if (prefixe == NULL)
+        return nom;
+    return concatener(e, prefixe, "::", nom);
+}
+
+/* "operator<" suivi d'arguments de modele prend un espace, comme
+   c++filt : "operator<< <char>". */
+static const char *ajouter_arguments_modele(struct etat *e, const char *nom)
+{
+    const char *arguments = lire_arguments_modele(e);
+    if (arguments == NULL)
+        return NULL;
+
+    size_t taille = strlen(nom);
+    if (taille > 0 && nom[taille - 1] == '<')
+        return concatener(e, nom, " ", arguments);
+    return concatener(e, nom, arguments, "");
+}
+
+static const char *lire_nom_imbrique(struct etat *e, struct info_nom *info)
+{
+    int constant = 0;
+    int volatil = 0;
+    int restreint = 0;
+    const char *reference = "";
+
+    e->p++;
+    if (*e->p == 'r')
+    {
+        restreint = 1;
+        e->p++;
+    }
+    if (*e->p == 'V')
+    {
+        volatil = 1;
+        e->p++;
+    }
+    if (*e->p == 'K')
+    {
+        constant = 1;
+        e->p++;
+    }
+    if (*e->p == 'R' || *e->p == 'O')
+    {
+        reference = *e->p == 'R' ? " &" : " &&";
+        e->p++;
+    }
+
+    info->qualificatifs =
+        concatener(e, constant ? " const" : "", volatil ? " volatile" : "",
+                   restreint ? " restrict" : "");
+    if (info->qualificatifs == NULL)
+        return NULL;
+    info->qualificatifs = concatener(e, info->qualificatifs, reference, "");
+
+    const char *nom = NULL;
+    while (*e->p != 'E')
+    {
+        if (*e->p == 'S' && e->p[1] == 't')
+        {
+            e->p += 2;
+            nom = joindre(e, nom, "std");
+            continue;
+        }
+
+        if (*e->p == 'S')
+        {
+            if (nom != NULL)
+                return NULL;
+            nom = lire_substitution(e);
+            info->modele = 0;
+            info->special = 0;
+        }
+        else if (*e->p == 'T')
+        {
+            if (nom != NULL)
+                return NULL;
+            nom = texte_parametre_modele(e);
+            if (nom != NULL && *e->p != 'E')
+                ajouter_substitution_nom(e, nom);
+            info->modele = 0;
+            info->special = 0;
+        }
+        else if (*e->p == 'I')
+        {
+            if (nom == NULL)
+                return NULL;
+            nom = ajouter_arguments_modele(e, nom);
+            if (nom != NULL && *e->p != 'E')
+                ajouter_substitution_nom(e, nom);
+            info->modele = 1;
+        }
+        else if (*e->p == 'M')
+            e->p++;
+        else
+        {
+            const char *composant = lire_nom_non_qualifie(e, nom, info);
+            nom = composant ? joindre(e, nom, composant) : NULL;
+            if (nom != NULL && *e->p != 'E')
+                ajouter_substitution_nom(e, nom);
+            info->modele = 0;
+        }
+
+        if (nom == NULL)
+            return NULL;
+    }
+    e->p++;
+    return nom;
+}
+
+static const char *lire_nom_local(struct etat *e, struct info_nom *info)
+{
+    e->p++;
+    const char *fonction = lire_encodage(e, 0);
+    if (fonction == NULL || *e->p != 'E')
+        return NULL;
+    e->p++;
+
+    const char *entite;
+    if (*e->p == 's')
+    {
+        e->p++;
+        entite = "string literal";
+        info->modele = 0;
+        info->special = 0;
+    }
+    else
+    {
+        entite = lire_nom(e, info);
+        if (entite == NULL)
+            return NULL;
+    }
+
+    /* Discriminant "_n" ou "__n_", ignore a l'affichage. */
+    if (e->p[0] == '_' && isdigit((unsigned char)e->p[1]))
+    {
+        e->p++;
+        lire_nombre(e);
+    }
+    else if (e->p[0] == '_' && e->p[1] == '_')
+    {
+        e->p += 2;
+        if (lire_nombre(e) < 0 || *e->p != '_')
+            return NULL;
+        e->p++;
+    }
+
+    return joindre(e, fonction, entite);
+}
+
+static const char *lire_nom(struct etat *e, struct info_nom *info)
+{
+    if (++e->recursion > MAX_RECURSION)
+        return NULL;
+
+    info->modele = 0;
+    info->special = 0;
+    info->qualificatifs = "";
+
+    const char *nom;
+    if (*e->p == 'N')
+        nom = lire_nom_imbrique(e, info);
+    else if (*e->p == 'Z')
+        nom = lire_nom_local(e, info);
+    else
+    {
+        if (*e->p == 'S' && e->p[1] == 't')
+        {
+            e->p += 2;
+            const char *composant = lire_nom_non_qualifie(e, "std", info);
+            nom = composant ? joindre(e, "std", composant) : NULL;
+            if (nom != NULL && *e->p == 'I')
+                ajouter_substitution_nom(e, nom);
+        }
+        else if (*e->p == 'S')
+            nom = lire_substitution(e);
+        else
+        {
+            nom = lire_nom_non_qualifie(e, NULL, info);
+            if (nom != NULL && *e->p == 'I')
+                ajouter_substitution_nom(e, nom);
+        }
+
+        if (nom != NULL && *e->p == 'I')
+        {
+            nom = ajouter_arguments_modele(e, nom);
+            info->modele = 1;
+        }
+    }
+
+    e->recursion--;
+    return nom;
+}
+
+/* Qualificatifs r/V/K : "const" s'affiche apres le type, comme c++filt. */
+static int lire_type_qualifie(struct etat *e, struct type_dem *type)
+{
+    int constant = 0;
+    int volatil = 0;
+    int restreint = 0;
+
+    while (*e->p == 'r' || *e->p == 'V' || *e->p == 'K')
+    {
+        if (*e->p == 'r')
+            restreint = 1;
+        else if (*e->p == 'V')
+            volatil = 1;
+        else
+            constant = 1;
+        e->p++;
+    }
+
+    struct type_dem interne;
+    int nb_substitutions = e->nb_substitutions;
+    int type_fonction = *e->p == 'F';
+    if (lire_type(e, &interne) != 0)
+        return -1;
+
+    /* Un type fonction qualifie ne compte qu'une fois. */
+    int fonction = interne.droite[0] != '\0' && !interne.parenthese
+        && !interne.tableau;
+    if (type_fonction && e->nb_substitutions > nb_substitutions)
+        e->nb_substitutions--;
+
+    const char *suffixe =
+        concatener(e, constant ? " const" : "", volatil ? " volatile" : "",
+                   restreint ? " restrict" : "");
+    if (suffixe == NULL)
+        return -1;
+
+    *type = interne;
+    size_t taille = strlen(interne.gauche);
+    if (fonction)
+        type->droite = concatener(e, interne.droite, suffixe, "");
+    else if (interne.tableau && !interne.parenthese && taille > 0
+             && interne.gauche[taille - 1] == ' ')
+    {
+        /* Tableau venu d'un argument de modele : "char const [4]". */
+        const char *element = copier_morceau(e, interne.gauche, taille - 1);
+        type->gauche = element ? concatener(e, element, suffixe, " ") : NULL;
+    }
+    else
+        type->gauche = concatener(e, interne.gauche, suffixe, "");
+    if (type->gauche == NULL || type->droite == NULL)
+        return -1;
+
+    ajouter_substitution(e, type);
+    return 0;
+}
+
+/* Pointeur, reference : "*" s'insere avant la partie droite. */
+static int lire_type_pointeur(struct etat *e, struct type_dem *type)
+{
+    const char *symbole = *e->p == 'P' ? "*" : *e->p == 'R' ? "&" : "&&";
+    e->p++;
+
+    struct type_dem interne;
+    if (lire_type(e, &interne) != 0)
+        return -1;
+
+    *type = interne;
+    size_t taille = strlen(interne.gauche);
+    if (symbole[0] == '&' && taille > 0 && interne.gauche[taille - 1] == '&')
+    {
+        /* Regle de reduction : "T& &&" donne "T&", "T&& &" donne "T&",
+           y compris pour "char (&) [4]". */
+        if (symbole[1] == '\0' && taille > 1
+            && interne.gauche[taille - 2] == '&')
+            type->gauche = copier_morceau(e, interne.gauche, taille - 1);
+    }
+    else if (interne.droite[0] != '\0' && !interne.parenthese)
+    {
+        type->gauche = concatener(e, interne.gauche, "(", symbole);
+        type->droite = concatener(e, interne.tableau ? ") " : ")",
+                                  interne.droite, "");
+        type->parenthese = 1;
+    }
+    else
+        type->gauche = concatener(e, interne.gauche, symbole, "");
+    if (type->gauche == NULL || type->droite == NULL)
+        return -1;
+
+    ajouter_substitution(e, type);
+    return 0;
+}
+
+static int lire_type_fonction(struct etat *e, struct type_dem *type)
+{
+    e->p++;
+    if (*e->p == 'Y')
+        e->p++;
+
+    struct type_dem retour;
+    if (lire_type(e, &retour) != 0)
+        return -1;
+    const char *texte_retour = rendre(e, &retour);
+
+    const char *parametres = lire_parametres(e);
+    const char *reference = "";
+    if (parametres != NULL && (*e->p == 'R' || *e->p == 'O')
+        && e->p[1] == 'E')
+    {
+        reference = *e->p == 'R' ? " &" : " &&";
+        e->p++;
+    }
+    if (texte_retour == NULL || parametres == NULL || *e->p != 'E')
+        return -1;
+    e->p++;
+
+    type->gauche = concatener(e, texte_retour, " ", "");
+    type->droite = concatener(e, parametres, reference, "");
+    type->parenthese = 0;
+    type->tableau = 0;
+    if (type->gauche == NULL || type->droite == NULL)
+        return -1;
+
+    ajouter_substitution(e, type);
+    return 0;
+}
+
+static int lire_type_tableau(struct etat *e, struct type_dem *type)
+{
+    e->p++;
+    const char *dimension;
+    if (*e->p == 'T')
+        dimension = texte_parametre_modele(e);
+    else
+    {
+        const char *debut = e->p;
+        while (isdigit((unsigned char)*e->p))
+            e->p++;
+        dimension = copier_morceau(e, debut, (size_t)(e->p - debut));
+    }
+    if (*e->p != '_')
+        return -1;
+    e->p++;
+
+    struct type_dem element;
+    if (lire_type(e, &element) != 0 || dimension == NULL)
+        return -1;
+
+    const char *crochets = concatener(e, "[", dimension, "]");
+    if (crochets == NULL)
+        return -1;
+
+    if (element.tableau && !element.parenthese)
+    {
+        type->gauche = element.gauche;
+        type->droite = concatener(e, crochets, element.droite, "");
+    }
+    else
+    {
+        const char *texte = rendre(e, &element);
+        type->gauche = texte ? concatener(e, texte, " ", "") : NULL;
+        type->droite = crochets;
+    }
+    type->parenthese = 0;
+    type->tableau = 1;
+    if (type->gauche == NULL || type->droite == NULL)
+        return -1;
+
+    ajouter_substitution(e, type);
+    return 0;
+}
+
+static int lire_type_membre(struct etat *e, struct type_dem *type)
+{
+    e->p++;
+
+    struct type_dem classe;
+    struct type_dem membre;
+    if (lire_type(e, &classe) != 0 || lire_type(e, &membre) != 0)
+        return -1;
+
+    const char *texte_classe = rendre(e, &classe);
+    if (texte_classe == NULL)
+        return -1;
+
+    if (membre.droite[0] != '\0' && !membre.parenthese)
+    {
+        const char *ouverture = concatener(e, "(", texte_classe, "::*");
+        type->gauche =
+            ouverture ? concatener(e, membre.gauche, ouverture, "") : NULL;
+        type->droite = concatener(e, ")", membre.droite, "");
+        type->parenthese = 1;
+    }
+    else
+    {
+        const char *texte_membre = rendre(e, &membre);
+        type->gauche = texte_membre
+            ? concatener(e, texte_membre, " ", texte_classe)
+            : NULL;
+        if (type->gauche != NULL)
+            type->gauche = concatener(e, type->gauche, "::*", "");
+        type->droite = "";
+        type->parenthese = 0;
+    }
+    type->tableau = 0;
+    if (type->gauche == NULL || type->droite == NULL)
+        return -1;
+
+    ajouter_substitution(e, type);
+    return 0;
+}
+
+/* "Dp <type>" : le type est relu pour chaque element du paquet qu'il
+   mentionne ; seule la premiere lecture ajoute des substitutions. */
+static int lire_expansion(struct etat *e, struct type_dem *type)
+{
+    const char *debut = e->p;
+    int dans_expansion = e->dans_expansion;
+    int indice_paquet = e->indice_paquet;
+    struct parametre *paquet = e->paquet;
+
+    e->dans_expansion = 1;
+    e->indice_paquet = 0;
+    e->paquet = NULL;
+
+    struct type_dem element;
+    int resultat = lire_type(e, &element);
+    const char *texte = resultat == 0 ? rendre(e, &element) : NULL;
+    const char *fin = e->p;
+
+    if (texte != NULL && e->paquet != NULL)
+    {
+        int nb_elements = e->paquet->nb_elements;
+        int nb_substitutions = e->nb_substitutions;
+        if (nb_elements == 0)
+            texte = "";
+        for (int i = 1; i < nb_elements && texte != NULL; i++)
+        {
+            e->p = debut;
+            e->indice_paquet = i;
+            if (lire_type(e, &element) != 0)
+                texte = NULL;
+            else
+            {
+                const char *suivant = rendre(e, &element);
+                texte = suivant ? concatener(e, texte, ", ", suivant) : NULL;
+            }
+        }
+        e->nb_substitutions = nb_substitutions;
+        e->p = fin;
+    }
+
+    e->dans_expansion = dans_expansion;
+    e->indice_paquet = indice_paquet;
+    e->paquet = paquet;
+    if (texte == NULL)
+        return -1;
+
+    *type = type_simple(texte);
+    ajouter_substitution(e, type);
+    return 0;
+}
+
+static int lire_type_etendu(struct etat *e, struct type_dem *type)
+{
+    static const struct operateur types_d[] = {
+        { "n", "decltype(nullptr)" }, { "a", "auto" },
+        { "c", "decltype(auto)" },    { "i", "char32_t" },
+        { "s", "char16_t" },          { "u", "char8_t" },
+        { "f", "decimal32" },         { "d", "decimal64" },
+        { "e", "decimal128" },        { "h", "half" },
+    };
+
+    e->p++;
+    if (*e->p == 'p')
+    {
+        e->p++;
+        return lire_expansion(e, type);
+    }
+
+    if (*e->p == 'F')
+    {
+        e->p++;
+        const char *debut = e->p;
+        while (isdigit((unsigned char)*e->p))
+            e->p++;
+        if (e->p == debut || *e->p != '_')
+            return -1;
+        const char *bits = copier_morceau(e, debut, (size_t)(e->p - debut));
+        e->p++;
+        if (bits == NULL)
+            return -1;
+        *type = type_simple(concatener(e, "_Float", bits, ""));
+        return type->gauche ? 0 : -1;
+    }
+
+    for (size_t i = 0; i < sizeof(types_d) / sizeof(types_d[0]); i++)
+    {
+        if (*e->p == types_d[i].code[0])
+        {
+            e->p++;
+            *type = type_simple(types_d[i].nom);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int lire_type_nomme(struct etat *e, struct type_dem *type)
+{
+    const char *nom;
+
+    if (*e->p == 'S' && e->p[1] != 't')
+    {
+        nom = lire_substitution(e);
+        if (nom == NULL)
+            return -1;
+        if (*e->p != 'I')
+        {
+            *type = type_simple(nom);
+            return 0;
+        }
+        nom = ajouter_arguments_modele(e, nom);
+    }
+    else if (*e->p == 'T')
+    {
+        if (lire_parametre_modele(e, type) != 0)
+            return -1;
+        ajouter_substitution(e, type);
+        if (*e->p != 'I')
+            return 0;
+        nom = rendre(e, type);
+        nom = nom ? ajouter_arguments_modele(e, nom) : NULL;
+    }
+    else
+    {
+        struct info_nom info;
+        nom = lire_nom(e, &info);
+    }
+
+    if (nom == NULL)
+        return -1;
+    *type = type_simple(nom);
+    ajouter_substitution(e, type);
+    return 0;
+}
+
+static int lire_type(struct etat *e, struct type_dem *type)
+{
+    char c = *e->p;
+    int resultat;
+
+    if (++e->recursion > MAX_RECURSION)
+        return -1;
+
+    if (c >= 'a' && c <= 'z' && types_simples[c - 'a'] != NULL)
+    {
+        e->p++;
+        *type = type_simple(types_simples[c - 'a']);
+        resultat = 0;
+    }
+    else if (c == 'u')
+    {
+        e->p++;
+        const char *nom = lire_nom_source(e);
+        *type = type_simple(nom);
+        resultat = nom ? 0 : -1;
+        if (nom != NULL)
+            ajouter_substitution(e, type);
+    }
+    else if (c == 'r' || c == 'V' || c == 'K')
+        resultat = lire_type_qualifie(e, type);
+    else if (c == 'P' || c == 'R' || c == 'O')
+        resultat = lire_type_pointeur(e, type);
+    else if (c == 'F')
+        resultat = lire_type_fonction(e, type);
+    else if (c == 'A')
+        resultat = lire_type_tableau(e, type);
+    else if (c == 'M')
+        resultat = lire_type_membre(e, type);
+    else if (c == 'D')
+        resultat = lire_type_etendu(e, type);
+    else if (c == 'N' || c == 'Z' || c == 'S' || c == 'T'
+             || isdigit((unsigned char)c))
+        resultat = lire_type_nomme(e, type);
+    else
+        resultat = -1;
+
+    e->recursion--;
+    return resultat;
+}
+
+/* Decalage d'un thunk : "h <n> _" ou "v <n> _ <n> _". */
+static int lire_decalage_appel(struct etat *e)
+{
+    int nb_nombres;
+    if (*e->p == 'h')
+        nb_nombres = 1;
+    else if (*e->p == 'v')
+        nb_nombres = 2;
+    else
+        return -1;
+    e->p++;
+
+    for (int i = 0; i < nb_nombres; i++)
+    {
+        if (*e->p == 'n')
+            e->p++;
+        if (lire_nombre(e) < 0 || *e->p != '_')
+            return -1;
+        e->p++;
+    }
+    return 0;
+}
+
+static const char *lire_nom_special(struct etat *e)
+{
+    static const struct operateur tables[] = {
+        { "TV", "vtable for " },
+        { "TT", "VTT for " },
+        { "TI", "typeinfo for " },
+        { "TS", "typeinfo name for " },
+    };
+
+    for (size_t i = 0; i < sizeof(tables) / sizeof(tables[0]); i++)
+    {
+        if (e->p[0] == tables[i].code[0] && e->p[1] == tables[i].code[1])
+        {
+            struct type_dem type;
+            e->p += 2;
+            e->profondeur_type++;
+            int resultat = lire_type(e, &type);
+            e->profondeur_type--;
+            const char *texte = resultat == 0 ? rendre(e, &type) : NULL;
+            return texte ? concatener(e, tables[i].nom, texte, "") : NULL;
+        }
+    }
+
+    const char *prefixe;
+    const char *nom;
+    struct info_nom info;
+
+    if (e->p[0] == 'T' && e->p[1] == 'C')
+    {
+        struct type_dem derive;
+        struct type_dem base;
+        e->p += 2;
+        e->profondeur_type++;
+        int resultat = lire_type(e, &derive);
+        if (resultat == 0 && (lire_nombre(e) < 0 || *e->p++ != '_'))
+            resultat = -1;
+        if (resultat == 0)
+            resultat = lire_type(e, &base);
+        e->profondeur_type--;
+        if (resultat != 0)
+            return NULL;
+
+        const char *texte = rendre(e, &base);
+        texte = texte ? concatener(e, "construction vtable for ", texte,
+                                   "-in-")
+                      : NULL;
+        const char *texte_derive = rendre(e, &derive);
+        return texte && texte_derive
+            ? concatener(e, texte, texte_derive, "")
+            : NULL;
+    }
+
+    if (e->p[0] == 'T' && (e->p[1] == 'h' || e->p[1] == 'v'))
+    {
+        prefixe = e->p[1] == 'h' ? "non-virtual thunk to "
+                                 : "virtual thunk to ";
+        e->p++;
+        if (lire_decalage_appel(e) != 0)
+            return NULL;
+        nom = lire_encodage(e, 1);
+    }
+    else if (e->p[0] == 'T' && e->p[1] == 'c')
+    {
+        prefixe = "covariant return thunk to ";
+        e->p += 2;
+        if (lire_decalage_appel(e) != 0 || lire_decalage_appel(e) != 0)
+            return NULL;
+        nom = lire_encodage(e, 1);
+    }
+    else if (e->p[0] == 'T' && (e->p[1] == 'H' || e->p[1] == 'W'))
+    {
+        prefixe = e->p[1] == 'H' ? "TLS init function for "
+                                 : "TLS wrapper function for ";
+        e->p += 2;
+        nom = lire_nom(e, &info);
+    }
+    else if (e->p[0] == 'G' && e->p[1] == 'T' && e->p[2] == 't')
+    {
+        prefixe = "transaction clone for ";
+        e->p += 3;
+        nom = lire_encodage(e, 1);
+    }
+    else if (e->p[0] == 'G' && e->p[1] == 'V')
+    {
+        prefixe = "guard variable for ";
+        e->p += 2;
+        nom = lire_nom(e, &info);
+    }
+    else if (e->p[0] == 'G' && e->p[1] == 'R')
+    {
+        prefixe = "reference temporary for ";
+        e->p += 2;
+        nom = lire_nom(e, &info);
+        if (nom != NULL && lire_sequence(e) < 0)
+            return NULL;
+    }
+    else
+        return NULL;
+
+    return nom ? concatener(e, prefixe, nom, "") : NULL;
+}
+
+/* c++filt omet le type de retour de la fonction englobant un nom
+   local : avec_retour vaut alors 0. */
+static const char *lire_encodage(struct etat *e, int avec_retour)
+{
+    if (*e->p == 'T' || *e->p == 'G')
+        return lire_nom_special(e);
+
+    struct info_nom info;
+    const char *nom = lire_nom(e, &info);
+    if (nom == NULL)
+        return NULL;
+    if (*e->p == '\0' || *e->p == 'E' || *e->p == '.')
+        return nom;
+
+    /* Les modeles de fonction encodent leur type de retour. */
+    const char *retour = "";
+    if (info.modele && !info.special)
+    {
+        struct type_dem type;
+        e->profondeur_type++;
+        int resultat = lire_type(e, &type);
+        e->profondeur_type--;
+        if (resultat != 0)
+            return NULL;
+        if (avec_retour)
+        {
+            retour = rendre(e, &type);
+            retour = retour ? concatener(e, retour, " ", "") : NULL;
+        }
+        if (retour == NULL)
+            return NULL;
+    }
+
+    const char *parametres = lire_parametres(e);
+    if (parametres == NULL)
+        return NULL;
+
+    const char *signature = concatener(e, retour, nom, parametres);
+    return signature ? concatener(e, signature, info.qualificatifs, "")
+                     : NULL;
+}
+
+/* Suffixes de clones de GCC : ".constprop.0", ".isra.0", ".cold"... */
+static const char *lire_clones(struct etat *e, const char *nom)
+{
+    while (nom != NULL && *e->p == '.')
+    {
+        const char *debut = e->p++;
+        if (isalpha((unsigned char)*e->p) || *e->p == '_')
+        {
+            while (isalpha((unsigned char)*e->p) || *e->p == '_')
+                e->p++;
+        }
+        else if (isdigit((unsigned char)*e->p))
+        {
+            while (isdigit((unsigned char)*e->p))
+                e->p++;
+        }
+        else
+            return NULL;
+
+        while (e->p[0] == '.' && isdigit((unsigned char)e->p[1]))
+        {
+            e->p++;
+            while (isdigit((unsigned char)*e->p))
+                e->p++;
+        }
+
+        const char *clone = copier_morceau(e, debut, (size_t)(e->p - debut));
+        nom = clone ? concatener(e, nom, " [clone ", clone) : NULL;
+        nom = nom ? concatener(e, nom, "]", "") : NULL;
+    }
+    return nom;
+}
+
+const char *demangler(const char *nom, struct arene *arene)
+{
+    if (nom == NULL || nom[0] != '_' || nom[1] != 'Z')
+        return NULL;
+
+    struct etat *e = arene_allouer(arene, sizeof(struct etat));
+    if (e == NULL)
+        return NULL;
+    memset(e, 0, sizeof(*e));
+    e->p = nom + 2;
+    e->arene = arene;
+
+    const char *resultat = lire_clones(e, lire_encodage(e, 1));
+    if (resultat == NULL || *e->p != '\0')
+        return NULL;
+    return resultat;
+}
+
+void initialiser_table_noms(struct table_noms *table)
+{
+    memset(table, 0, sizeof(*table));
+}
+
+static size_t position_cle(uint64_t cle, size_t capacite)
+{
+    return (size_t)((cle * 0x9E3779B97F4A7C15ULL) >> 32) & (capacite - 1);
+}
+
+static int agrandir_table_noms(struct table_noms *table)
+{
+    size_t capacite = table->capacite ? table->capacite * 2 : 1024;
+    uint64_t *cles = calloc(capacite, sizeof(uint64_t));
+    const char **valeurs = calloc(capacite, sizeof(const char *));
+    if (cles == NULL || valeurs == NULL)
+    {
+        free(cles);
+        free(valeurs);
+        return 0;
+    }
+
+    for (size_t i = 0; i < table->capacite; i++)
+    {
+        if (table->cles[i] == 0)
+            continue;
+        size_t j = position_cle(table->cles[i], capacite);
+        while (cles[j] != 0)
+            j = (j + 1) & (capacite - 1);
+        cles[j] = table->cles[i];
+        valeurs[j] = table->valeurs[i];
+    }
+
+    free(table->cles);
+    free(table->valeurs);
+    table->cles = cles;
+    table->valeurs = valeurs;
+    table->capacite = capacite;
+    return 1;
+}
+
+/* Les noms non mangles sont rendus tels quels sans passer par la table ;
+   un echec du demangleur est memorise aussi, pour ne pas reessayer. */
+const char *nom_demangle(struct table_noms *table, uint32_t decalage,
+                         const char *nom)
+{
+    if (nom[0] != '_' || nom[1] != 'Z')
+        return nom;
+
+    if ((table->nb + 1) * 4 > table->capacite * 3
+        && !agrandir_table_noms(table))
+        return nom;
+
+    uint64_t cle = (uint64_t)decalage + 1;
+    size_t i = position_cle(cle, table->capacite);
+    while (table->cles[i] != 0)
+    {
+        if (table->cles[i] == cle)
+            return table->valeurs[i];
+        i = (i + 1) & (table->capacite - 1);
+    }
+
+    const char *resultat = demangler(nom, &table->travail);
+    const char *valeur = resultat ? arene_copier(&table->noms, resultat) : NULL;
+    arene_vider(&table->travail);
+
+    table->cles[i] = cle;
+    table->valeurs[i] = valeur ? valeur : nom;
+    table->nb++;
+    return table->valeurs[i];
+}
+
+void liberer_table_noms(struct table_noms *table)
+{
+    free(table->cles);
+    free(table->valeurs);
+    arene_liberer(&table->noms);
+    arene_liberer(&table->travail);
+    memset(table, 0, sizeof(*table));
+}
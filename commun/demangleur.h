@@ -0,0 +1,40 @@
+#ifndef DEMANGLEUR_H
+#define DEMANGLEUR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Arene : blocs chaines, liberes d'un seul coup. */
+struct bloc_arene;
+
+struct arene
+{
+    struct bloc_arene *bloc;
+};
+
+void *arene_allouer(struct arene *arene, size_t taille);
+char *arene_copier(struct arene *arene, const char *texte);
+void arene_vider(struct arene *arene);
+void arene_liberer(struct arene *arene);
+
+/* Demangle un nom C++ Itanium (_Z...). Renvoie NULL si le nom n'est pas
+   mangle ou pas reconnu ; le resultat est alloue dans l'arene. */
+const char *demangler(const char *nom, struct arene *arene);
+
+/* Noms demangles memorises par decalage dans la table de chaines. */
+struct table_noms
+{
+    uint64_t *cles;
+    const char **valeurs;
+    size_t capacite;
+    size_t nb;
+    struct arene noms;
+    struct arene travail;
+};
+
+void initialiser_table_noms(struct table_noms *table);
+const char *nom_demangle(struct table_noms *table, uint32_t decalage,
+                         const char *nom);
+void liberer_table_noms(struct table_noms *table);
+
+#endif
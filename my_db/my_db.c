@@ -1,7 +1,12 @@
 #include <elf.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <immintrin.h>
+#include <limits.h>
 #include <signal.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,8 +16,141 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include "../commun/demangleur.h"
+
 #define TAILLE_MAX_CMD 256
+
+/* Constantes DWARF utilisees par les decodeurs de .debug_line, de
+ * .debug_info et de .eh_frame. */
+#define DW_FORM_addr 0x01
+#define DW_FORM_block2 0x03
+#define DW_FORM_block4 0x04
+#define DW_FORM_data2 0x05
+#define DW_FORM_data4 0x06
+#define DW_FORM_data8 0x07
+#define DW_FORM_string 0x08
+#define DW_FORM_block 0x09
+#define DW_FORM_block1 0x0a
+#define DW_FORM_data1 0x0b
+#define DW_FORM_flag 0x0c
+#define DW_FORM_sdata 0x0d
+#define DW_FORM_strp 0x0e
+#define DW_FORM_udata 0x0f
+#define DW_FORM_ref_addr 0x10
+#define DW_FORM_ref1 0x11
+#define DW_FORM_ref2 0x12
+#define DW_FORM_ref4 0x13
+#define DW_FORM_ref8 0x14
+#define DW_FORM_ref_udata 0x15
+#define DW_FORM_indirect 0x16
+#define DW_FORM_sec_offset 0x17
+#define DW_FORM_exprloc 0x18
+#define DW_FORM_flag_present 0x19
+#define DW_FORM_strx 0x1a
+#define DW_FORM_addrx 0x1b
+#define DW_FORM_ref_sup4 0x1c
+#define DW_FORM_strp_sup 0x1d
+#define DW_FORM_data16 0x1e
+#define DW_FORM_line_strp 0x1f
+#define DW_FORM_ref_sig8 0x20
+#define DW_FORM_implicit_const 0x21
+#define DW_FORM_loclistx 0x22
+#define DW_FORM_rnglistx 0x23
+#define DW_FORM_ref_sup8 0x24
+#define DW_FORM_strx1 0x25
+#define DW_FORM_strx2 0x26
+#define DW_FORM_strx3 0x27
+#define DW_FORM_strx4 0x28
+#define DW_FORM_addrx1 0x29
+#define DW_FORM_addrx2 0x2a
+#define DW_FORM_addrx3 0x2b
+#define DW_FORM_addrx4 0x2c
+#define DW_AT_stmt_list 0x10
+#define DW_AT_low_pc 0x11
+#define DW_AT_high_pc 0x12
+#define DW_UT_compile 0x01
+#define DW_UT_partial 0x03
+#define DW_LNCT_path 0x1
+#define DW_LNS_copy 1
+#define DW_LNS_advance_pc 2
+#define DW_LNS_advance_line 3
+#define DW_LNS_set_file 4
+#define DW_LNS_negate_stmt 6
+#define DW_LNS_const_add_pc 8
+#define DW_LNS_fixed_advance_pc 9
+#define DW_LNE_end_sequence 1
+#define DW_LNE_set_address 2
+#define DW_CFA_advance_loc 0x40
+#define DW_CFA_offset 0x80
+#define DW_CFA_restore 0xc0
+#define DW_CFA_nop 0x00
+#define DW_CFA_set_loc 0x01
+#define DW_CFA_advance_loc1 0x02
+#define DW_CFA_advance_loc2 0x03
+#define DW_CFA_advance_loc4 0x04
+#define DW_CFA_offset_extended 0x05
+#define DW_CFA_restore_extended 0x06
+#define DW_CFA_undefined 0x07
+#define DW_CFA_same_value 0x08
+#define DW_CFA_register 0x09
+#define DW_CFA_remember_state 0x0a
+#define DW_CFA_restore_state 0x0b
+#define DW_CFA_def_cfa 0x0c
+#define DW_CFA_def_cfa_register 0x0d
+#define DW_CFA_def_cfa_offset 0x0e
+#define DW_CFA_def_cfa_expression 0x0f
+#define DW_CFA_expression 0x10
+#define DW_CFA_offset_extended_sf 0x11
+#define DW_CFA_def_cfa_sf 0x12
+#define DW_CFA_def_cfa_offset_sf 0x13
+#define DW_CFA_val_offset 0x14
+#define DW_CFA_val_offset_sf 0x15
+#define DW_CFA_val_expression 0x16
+#define DW_CFA_GNU_args_size 0x2e
+#define DW_CFA_GNU_negative_offset_extended 0x2f
+#define DW_EH_PE_omit 0xff
+#define DW_EH_PE_absptr 0x00
+#define DW_EH_PE_uleb128 0x01
+#define DW_EH_PE_udata2 0x02
+#define DW_EH_PE_udata4 0x03
+#define DW_EH_PE_udata8 0x04
+#define DW_EH_PE_sleb128 0x09
+#define DW_EH_PE_sdata2 0x0a
+#define DW_EH_PE_sdata4 0x0b
+#define DW_EH_PE_sdata8 0x0c
+#define DW_EH_PE_pcrel 0x10
 #define MAX_POINTS_ARRET 100
+#define MAX_ARGUMENTS 16
+#define MAX_POINTS_TRACE 32
+
+#define TAILLE_PAGE 4096UL
+#define TAILLE_SAUT 5
+#define TAILLE_LECTURE_CODE 32
+#define TAILLE_MAX_MOTIF 64
+#define TAILLE_BLOC_RECHERCHE (4UL << 20)
+#define MAX_RESULTATS_RECHERCHE 100
+#define BIT_SOFT_DIRTY (1ULL << 55)
+#define TAILLE_MAX_ENREGISTREMENT (64UL << 20)
+#define INTERVALLE_POINTS_REPRISE 256
+#define NB_REGISTRES (sizeof(struct user_regs_struct) / sizeof(unsigned long long))
+#define INDICE_ORIG_RAX                                                       \
+    (offsetof(struct user_regs_struct, orig_rax) / sizeof(unsigned long long))
+#define ENTREE_PAS 0
+#define ENTREE_POINT_REPRISE 1
+#define MAX_DECALAGE_LIGNE 64
+#define MAX_ESSAIS_PAS_SOURCE 64
+#define MAX_ETATS_CFI 16
+#define TAILLE_MAX_TRAMPOLINE 128
+#define NB_ENTREES_JOURNAL 256
+#define TAILLE_ENTREE_JOURNAL 64
+/* Zone injectee : une page de code, une page de compteurs, puis le
+ * journal circulaire des registres. */
+#define ZONE_CODE 0
+#define ZONE_COMPTEURS TAILLE_PAGE
+#define ZONE_INDEX_JOURNAL (ZONE_COMPTEURS + MAX_POINTS_TRACE * 8)
+#define ZONE_JOURNAL (2 * TAILLE_PAGE)
+#define TAILLE_ZONE_TRACE                                                     \
+    (ZONE_JOURNAL + NB_ENTREES_JOURNAL * TAILLE_ENTREE_JOURNAL)
 
 struct donnees_elf
 {
@@ -24,6 +162,39 @@ struct donnees_elf
     char *table_symboles;
     size_t nb_symboles;
     Elf64_Sym *symboles;
+    unsigned char *debug_line;
+    size_t taille_debug_line;
+    char *debug_line_str;
+    size_t taille_debug_line_str;
+    char *debug_str;
+    size_t taille_debug_str;
+    unsigned char *debug_info;
+    size_t taille_debug_info;
+    unsigned char *debug_abbrev;
+    size_t taille_debug_abbrev;
+    unsigned char *debug_aranges;
+    size_t taille_debug_aranges;
+    unsigned char *eh_frame;
+    size_t taille_eh_frame;
+    unsigned long adresse_eh_frame;
+};
+
+struct debogueur;
+
+struct commande
+{
+    const char *nom;
+    const char *alias;
+    void (*fonction)(struct debogueur *dbg, int argc, char **argv);
+};
+
+/* Ligne analysee une fois : argv pointe dans ligne. */
+struct commande_analysee
+{
+    const struct commande *commande;
+    int argc;
+    char *argv[MAX_ARGUMENTS];
+    char ligne[TAILLE_MAX_CMD];
 };
 
 struct point_arret
@@ -33,6 +204,142 @@ struct point_arret
     long donnee_originale;
     char *symbole;
     int actif;
+    struct commande_analysee **commandes;
+    int nb_commandes;
+};
+
+struct point_trace
+{
+    int numero;
+    unsigned long adresse;
+    unsigned long trampoline;
+    size_t taille_deplacee;
+    unsigned char octets_originaux[TAILLE_MAX_TRAMPOLINE];
+    int journal;
+    int appel; /* un call deplace laisse des retours dans le trampoline */
+};
+
+struct instruction
+{
+    size_t longueur;
+    int rex;
+    int operande_16;
+    int adresse_32;
+    int carte; /* 1: un octet, 2: 0F, 3: 0F 38, 4: 0F 3A */
+    unsigned char opcode;
+    int a_modrm;
+    unsigned char modrm;
+    int a_sib;
+    unsigned char sib;
+    size_t pos_deplacement;
+    size_t taille_deplacement;
+    int rip_relatif;
+    size_t pos_immediat;
+    size_t taille_immediat;
+    int saut_relatif; /* taille du deplacement d'un saut relatif, 0 sinon */
+    int segment;      /* 0, ou 4 pour fs et 5 pour gs */
+    int vex;
+    int evex;
+    int evex_w;
+    int evex_pp;      /* 0, ou 1 a 3 pour 66, F3 et F2 */
+    int evex_b;       /* diffusion d'un element sur un operande memoire */
+    size_t taille_vecteur; /* 16, 32 ou 64 octets */
+};
+
+struct region_instantane
+{
+    unsigned long debut;
+    unsigned long fin;
+    unsigned char *copie;
+    uint64_t *empreintes;
+};
+
+struct instantane
+{
+    struct region_instantane *regions;
+    size_t nb_regions;
+    int suivi_pages; /* bits soft-dirty remis a zero */
+    int actif;
+};
+
+/* Journal d'execution : pour chaque pas, les pre-images memoire et les
+ * anciennes valeurs des registres modifies ; un point de reprise avec tous
+ * les registres tous les INTERVALLE_POINTS_REPRISE pas. */
+struct enregistrement
+{
+    int actif;
+    unsigned char *journal;
+    size_t taille;
+    size_t capacite;
+    size_t debut_entree;
+    unsigned long nb_pas;
+    unsigned long pas_depuis_reprise;
+};
+
+struct ligne_source
+{
+    unsigned long adresse;
+    unsigned fichier;
+    unsigned ligne;
+    unsigned ordre;
+    unsigned char stmt;
+    unsigned char fin_sequence;
+};
+
+/* Unite de .debug_line : l'en-tete est lu a l'indexation, le programme
+ * n'est decode qu'a la premiere recherche qui la concerne. */
+struct unite_lignes
+{
+    const unsigned char *entete; /* debut de l'unite dans .debug_line */
+    const unsigned char *programme;
+    const unsigned char *fin;
+    int version;
+    unsigned char longueur_min_instruction;
+    unsigned char stmt_defaut;
+    signed char base_lignes;
+    unsigned char plage_lignes;
+    unsigned char base_opcodes;
+    const unsigned char *longueurs_opcodes;
+    const char **fichiers; /* noms de base, indexes par numero DWARF */
+    size_t nb_fichiers;
+    int decodee;
+    struct ligne_source *lignes; /* triees par adresse */
+    size_t nb_lignes;
+    size_t capacite_lignes;
+    unsigned long bas;
+    unsigned long haut;
+    int plage_connue; /* couverte par la table des plages */
+};
+
+/* Plage d'adresses [bas, haut[ d'une unite, tiree de .debug_aranges ou des
+ * DW_AT_low_pc/high_pc de son unite de compilation. */
+struct plage_unite
+{
+    unsigned long bas;
+    unsigned long haut;
+    size_t unite;
+};
+
+struct entree_fichier_ligne
+{
+    uint32_t hachage;
+    const char *fichier;
+    unsigned ligne;
+    unsigned long adresse;
+    int suivante;
+};
+
+struct table_lignes
+{
+    int indexee;
+    struct unite_lignes *unites;
+    size_t nb_unites;
+    struct entree_fichier_ligne *entrees; /* index fichier:ligne */
+    size_t nb_entrees;
+    int *seaux;
+    size_t nb_seaux;
+    struct plage_unite *plages; /* triees par adresse */
+    size_t nb_plages;
 };
 
 struct debogueur
@@ -41,8 +348,45 @@ struct debogueur
     struct point_arret points_arret[MAX_POINTS_ARRET];
     int nb_points_arret;
     struct donnees_elf elf;
+    int fd_memoire;
+    unsigned long zone_trace;
+    struct point_trace points_trace[MAX_POINTS_TRACE];
+    int nb_points_trace;
+    int prochain_numero_trace;
+    struct instantane instantane;
+    struct enregistrement enregistrement;
+    struct table_lignes lignes;
+    FILE *entree;
+    int dans_commandes;
+    int arret_demande;
+    int demangle;
+    struct table_noms noms;
+    int echec; /* une commande a echoue ou le programme a plante */
+    int mode_script; /* -x ou --batch : echec rend un code non nul */
 };
 
+/* Message d'erreur d'une commande : en mode script, my_db se termine alors
+ * avec un code non nul (voir code_sortie). */
+static void echouer(struct debogueur *dbg, const char *format, ...)
+{
+    va_list arguments;
+    va_start(arguments, format);
+    vprintf(format, arguments);
+    va_end(arguments);
+    dbg->echec = 1;
+}
+
+static void echouer_systeme(struct debogueur *dbg, const char *message)
+{
+    perror(message);
+    dbg->echec = 1;
+}
+
+static int code_sortie(struct debogueur *dbg)
+{
+    return dbg->mode_script && dbg->echec ? 1 : 0;
+}
+
 static int lire_fichier_elf(const char *chemin, struct donnees_elf *donnees)
 {
     int fd = open(chemin, O_RDONLY);
@@ -110,6 +454,52 @@ static int lire_fichier_elf(const char *chemin, struct donnees_elf *donnees)
     }
     if (!trouve)
         return 0;
+
+    for (size_t i = 0; i < donnees->entete->e_shnum; i++)
+    {
+        Elf64_Shdr *section = &donnees->table_sections[i];
+        const char *nom = donnees->table_chaines + section->sh_name;
+        unsigned char *contenu = donnees->debut + section->sh_offset;
+        if (section->sh_type == SHT_NOBITS
+            || section->sh_offset + section->sh_size > donnees->taille)
+            continue;
+        if (strcmp(nom, ".debug_line") == 0)
+        {
+            donnees->debug_line = contenu;
+            donnees->taille_debug_line = section->sh_size;
+        }
+        else if (strcmp(nom, ".debug_line_str") == 0)
+        {
+            donnees->debug_line_str = (char *)contenu;
+            donnees->taille_debug_line_str = section->sh_size;
+        }
+        else if (strcmp(nom, ".debug_str") == 0)
+        {
+            donnees->debug_str = (char *)contenu;
+            donnees->taille_debug_str = section->sh_size;
+        }
+        else if (strcmp(nom, ".debug_info") == 0)
+        {
+            donnees->debug_info = contenu;
+            donnees->taille_debug_info = section->sh_size;
+        }
+        else if (strcmp(nom, ".debug_abbrev") == 0)
+        {
+            donnees->debug_abbrev = contenu;
+            donnees->taille_debug_abbrev = section->sh_size;
+        }
+        else if (strcmp(nom, ".debug_aranges") == 0)
+        {
+            donnees->debug_aranges = contenu;
+            donnees->taille_debug_aranges = section->sh_size;
+        }
+        else if (strcmp(nom, ".eh_frame") == 0)
+        {
+            donnees->eh_frame = contenu;
+            donnees->taille_eh_frame = section->sh_size;
+            donnees->adresse_eh_frame = section->sh_addr;
+        }
+    }
     return 1;
 }
 
@@ -118,6 +508,9 @@ static void gerer_signaux(struct debogueur *dbg, int sig)
     if (sig != SIGTRAP)
     {
         printf("Programme reçoit le signal %d\n", sig);
+        if (sig == SIGSEGV || sig == SIGBUS || sig == SIGFPE || sig == SIGILL
+            || sig == SIGABRT || sig == SIGSYS)
+            dbg->echec = 1;
         ptrace(PTRACE_CONT, dbg->pid_fils, NULL, sig);
     }
 }
@@ -157,7 +550,7 @@ static void afficher_memoire(struct debogueur *dbg, unsigned long addr,
         long data = ptrace(PTRACE_PEEKDATA, dbg->pid_fils, addr + i * 8, NULL);
         if (errno != 0)
         {
-            perror("ptrace peekdata");
+            echouer_systeme(dbg, "ptrace peekdata");
             return;
         }
         switch (format)
@@ -175,429 +568,4631 @@ static void afficher_memoire(struct debogueur *dbg, unsigned long addr,
     }
 }
 
-static void etape_suivante(struct debogueur *dbg, int nombre_pas)
+static int ouvrir_memoire(struct debogueur *dbg)
 {
-    for (int i = 0; i < nombre_pas; i++)
-    {
-        if (ptrace(PTRACE_SINGLESTEP, dbg->pid_fils, NULL, NULL) == -1)
-        {
-            perror("ptrace singlestep");
-            return;
-        }
-        int statut;
-        waitpid(dbg->pid_fils, &statut, 0);
+    if (dbg->fd_memoire != -1)
+        return 1;
 
-        if (WIFSTOPPED(statut))
-        {
-            if (WSTOPSIG(statut) == SIGTRAP)
-            {
-                struct user_regs_struct regs;
-                if (ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &regs) != -1)
-                {
-                    printf("Programme arrêté à 0x%llx\n", regs.rip);
-                }
-            }
-            else
-            {
-                gerer_signaux(dbg, WSTOPSIG(statut));
-                break;
-            }
-        }
-        else if (WIFEXITED(statut))
-        {
-            printf("Programme terminé avec le code %d\n", WEXITSTATUS(statut));
-            break;
-        }
+    char chemin[64];
+    snprintf(chemin, sizeof(chemin), "/proc/%d/mem", (int)dbg->pid_fils);
+    dbg->fd_memoire = open(chemin, O_RDWR);
+    if (dbg->fd_memoire == -1)
+    {
+        echouer_systeme(dbg, "open mem");
+        return 0;
     }
+    return 1;
 }
 
-static unsigned long recuperer_adresse_symbole(struct debogueur *dbg,
-                                               const char *symbole)
+static int lire_memoire(struct debogueur *dbg, unsigned long addr, void *tampon,
+                        size_t taille)
 {
-    struct user_regs_struct regs;
-    if (strcmp(symbole, "$rip") == 0)
-    {
-        if (ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &regs) != -1)
-            return regs.rip;
-    }
-    if (strcmp(symbole, "$rsp") == 0)
+    if (!ouvrir_memoire(dbg))
+        return 0;
+
+    size_t total = 0;
+    while (total < taille)
     {
-        if (ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &regs) != -1)
-            return regs.rsp;
+        ssize_t lu = pread(dbg->fd_memoire, (char *)tampon + total,
+                           taille - total, (off_t)(addr + total));
+        if (lu <= 0)
+            return 0;
+        total += (size_t)lu;
     }
-    if (!dbg->elf.symboles || !dbg->elf.table_symboles)
-        return (unsigned long)-1;
-    for (size_t i = 0; i < dbg->elf.nb_symboles; i++)
+    return 1;
+}
+
+/* Bornes de la region de /proc/<pid>/maps qui contient addr. */
+static int region_contenant(struct debogueur *dbg, unsigned long addr,
+                            unsigned long *debut, unsigned long *fin)
+{
+    char chemin[64];
+    snprintf(chemin, sizeof(chemin), "/proc/%d/maps", (int)dbg->pid_fils);
+    FILE *maps = fopen(chemin, "r");
+    if (!maps)
+        return 0;
+
+    int trouvee = 0;
+    char ligne[512];
+    while (!trouvee && fgets(ligne, sizeof(ligne), maps))
     {
-        if (dbg->elf.symboles[i].st_name
-            && ELF64_ST_TYPE(dbg->elf.symboles[i].st_info) == STT_FUNC
-            && strcmp(dbg->elf.table_symboles + dbg->elf.symboles[i].st_name,
-                      symbole)
-                == 0)
-        {
-            return dbg->elf.symboles[i].st_value;
-        }
+        if (sscanf(ligne, "%lx-%lx", debut, fin) == 2 && addr >= *debut
+            && addr < *fin)
+            trouvee = 1;
     }
-    return (unsigned long)-1;
+    fclose(maps);
+    return trouvee;
 }
 
-static void restaurer_point_arret(struct debogueur *dbg, struct point_arret *bp)
+/* Lit au plus taille octets de code : si la page suivante n'est pas
+ * projetee, la lecture s'arrete a la fin de la page de addr. Retourne
+ * le nombre d'octets lus. */
+static size_t lire_code(struct debogueur *dbg, unsigned long addr,
+                        unsigned char *code, size_t taille)
+{
+    if (lire_memoire(dbg, addr, code, taille))
+        return taille;
+    size_t jusqu_a_page = (size_t)(((addr | (TAILLE_PAGE - 1)) + 1) - addr);
+    if (jusqu_a_page >= taille || !lire_memoire(dbg, addr, code, jusqu_a_page))
+        return 0;
+    return jusqu_a_page;
+}
+
+static int ecrire_memoire(struct debogueur *dbg, unsigned long addr,
+                          const void *tampon, size_t taille)
 {
-    if (ptrace(PTRACE_POKEDATA, dbg->pid_fils, bp->adresse,
-               bp->donnee_originale)
-        == -1)
+    if (!ouvrir_memoire(dbg))
+        return 0;
+
+    size_t total = 0;
+    while (total < taille)
     {
-        perror("restauration point arret");
+        ssize_t ecrit = pwrite(dbg->fd_memoire, (const char *)tampon + total,
+                               taille - total, (off_t)(addr + total));
+        if (ecrit <= 0)
+            return 0;
+        total += (size_t)ecrit;
     }
+    return 1;
 }
 
-static int ajouter_point_arret(struct debogueur *dbg, unsigned long addr)
+static int opcode_invalide_1(unsigned char op)
 {
-    if (addr == 0 || addr == (unsigned long)-1)
+    switch (op)
     {
-        printf("Adresse invalide pour le point d'arrêt\n");
+    case 0x06: case 0x07: case 0x0E: case 0x16: case 0x17: case 0x1E:
+    case 0x1F: case 0x27: case 0x2F: case 0x37: case 0x3F: case 0x60:
+    case 0x61: case 0x82: case 0x9A: case 0xCE: case 0xD4:
+    case 0xD5: case 0xD6: case 0xEA:
+        return 1;
+    default:
         return 0;
     }
+}
 
-    if (dbg->nb_points_arret >= MAX_POINTS_ARRET)
+static int opcode_invalide_2(unsigned char op)
+{
+    switch (op)
     {
-        printf("Nombre maximum de points d'arrêt atteint\n");
+    case 0x04: case 0x0A: case 0x0C: case 0x0F: case 0x24: case 0x25:
+    case 0x26: case 0x27: case 0x36: case 0x39: case 0x3B: case 0x3C:
+    case 0x3D: case 0x3E: case 0x3F: case 0x7A: case 0x7B: case 0xA6:
+    case 0xA7:
+        return 1;
+    default:
         return 0;
     }
+}
 
-    errno = 0;
-    long donnee = ptrace(PTRACE_PEEKDATA, dbg->pid_fils, addr, NULL);
-    if (errno != 0)
+static int a_modrm_1(unsigned char op)
+{
+    if (op < 0x40)
+        return (op & 7) < 4;
+    if (op >= 0x80 && op <= 0x8F)
+        return 1;
+    if (op >= 0xD8 && op <= 0xDF)
+        return 1;
+    switch (op)
     {
-        perror("ptrace peek");
+    case 0x63: case 0x69: case 0x6B: case 0xC0: case 0xC1: case 0xC6:
+    case 0xC7: case 0xD0: case 0xD1: case 0xD2: case 0xD3: case 0xF6:
+    case 0xF7: case 0xFE: case 0xFF:
+        return 1;
+    default:
         return 0;
     }
+}
 
-    long int3 = (donnee & ~0xFF) | 0xCC;
-    if (ptrace(PTRACE_POKEDATA, dbg->pid_fils, addr, int3) == -1)
+static int a_modrm_2(unsigned char op)
+{
+    if ((op >= 0x30 && op <= 0x37) || (op >= 0x80 && op <= 0x8F)
+        || (op >= 0xC8 && op <= 0xCF))
+        return 0;
+    switch (op)
     {
-        perror("ptrace poke");
+    case 0x05: case 0x06: case 0x07: case 0x08: case 0x09: case 0x0B:
+    case 0x0E: case 0x77: case 0xA0: case 0xA1: case 0xA2: case 0xA8:
+    case 0xA9: case 0xAA:
         return 0;
+    default:
+        return 1;
     }
+}
 
-    struct point_arret *bp = &dbg->points_arret[dbg->nb_points_arret++];
-    bp->numero = dbg->nb_points_arret;
-    bp->adresse = addr;
-    bp->donnee_originale = donnee;
-    bp->actif = 1;
+static size_t taille_immediat_1(struct instruction *ins)
+{
+    unsigned char op = ins->opcode;
+    size_t z = ins->operande_16 ? 2 : 4;
+    int reg = (ins->modrm >> 3) & 7;
 
-    return 1;
+    if (op < 0x40 && (op & 7) == 4)
+        return 1;
+    if (op < 0x40 && (op & 7) == 5)
+        return z;
+    if (op >= 0x70 && op <= 0x7F)
+        return 1;
+    if (op >= 0xA0 && op <= 0xA3)
+        return ins->adresse_32 ? 4 : 8;
+    if (op >= 0xB0 && op <= 0xB7)
+        return 1;
+    if (op >= 0xB8 && op <= 0xBF)
+        return (ins->rex & 8) ? 8 : z;
+    if (op >= 0xE0 && op <= 0xE7)
+        return 1;
+    switch (op)
+    {
+    case 0x6A: case 0x6B: case 0x80: case 0x83: case 0xA8: case 0xC0:
+    case 0xC1: case 0xC6: case 0xCD: case 0xEB:
+        return 1;
+    case 0x68: case 0x69: case 0x81: case 0xA9: case 0xC7:
+        return z;
+    case 0xC2: case 0xCA:
+        return 2;
+    case 0xC8:
+        return 3;
+    case 0xE8: case 0xE9:
+        return 4;
+    case 0xF6:
+        return reg < 2 ? 1 : 0;
+    case 0xF7:
+        return reg < 2 ? z : 0;
+    default:
+        return 0;
+    }
 }
 
-static void gerer_point_arret(struct debogueur *dbg)
+static size_t taille_immediat_2(unsigned char op)
 {
-    struct user_regs_struct regs;
-    if (ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &regs) == -1)
+    if (op >= 0x80 && op <= 0x8F)
+        return 4;
+    if (op >= 0x70 && op <= 0x73)
+        return 1;
+    switch (op)
     {
-        perror("getregs failed");
-        return;
+    case 0xA4: case 0xAC: case 0xBA: case 0xC2: case 0xC4: case 0xC5:
+    case 0xC6:
+        return 1;
+    default:
+        return 0;
     }
+}
 
-    unsigned long pc = regs.rip - 1;
+/* Facteur N du deplacement compresse disp8*N d'EVEX : la taille de la
+ * tranche memoire lue ou ecrite. Les tuples qui ne portent pas sur le
+ * vecteur entier sont detailles pour les instructions qui ecrivent en
+ * memoire, dont l'adresse doit etre exacte pour l'enregistrement. */
+static size_t facteur_deplacement_evex(const struct instruction *ins)
+{
+    unsigned char op = ins->opcode;
+    size_t element = ins->carte >= 6 ? 2 : ins->evex_w ? 8 : 4;
+    size_t vecteur = ins->taille_vecteur;
 
-    for (int i = 0; i < dbg->nb_points_arret; i++)
+    if (ins->evex_b)
+        return element;
+    if (ins->carte == 2)
     {
-        if (dbg->points_arret[i].adresse == pc && dbg->points_arret[i].actif)
+        if (op == 0x11 && ins->evex_pp >= 2)
+            return ins->evex_pp == 2 ? 4 : 8;
+        if ((op == 0x13 || op == 0x17) && ins->evex_pp <= 1)
+            return 8;
+        if (op == 0x7E && ins->evex_pp == 1)
+            return element;
+        if (op == 0xD6 && ins->evex_pp == 1)
+            return 8;
+    }
+    else if (ins->carte == 3)
+    {
+        /* vpmov* vers la memoire : demi, quart ou huitieme de vecteur. */
+        int ligne = op >> 4;
+        int colonne = op & 0x0F;
+        if (ins->evex_pp == 2 && ligne >= 1 && ligne <= 3 && colonne <= 5)
+            return colonne == 0 || colonne == 3 || colonne == 5 ? vecteur / 2
+                : colonne == 2 ? vecteur / 8
+                               : vecteur / 4;
+        if (op == 0x63 || op == 0x8A || op == 0x8B
+            || (op >= 0xA0 && op <= 0xA3))
+            return op == 0x63 ? (ins->evex_w ? 2 : 1) : element;
+    }
+    else if (ins->carte == 4)
+    {
+        switch (op)
         {
-            if (ptrace(PTRACE_POKEDATA, dbg->pid_fils, pc,
-                       dbg->points_arret[i].donnee_originale)
-                == -1)
-            {
-                perror("restauration instruction");
-                return;
-            }
-
-            regs.rip = pc;
-            if (ptrace(PTRACE_SETREGS, dbg->pid_fils, NULL, &regs) == -1)
-            {
-                perror("setregs failed");
-                return;
-            }
-
-            printf("Breakpoint at 0x%lx\n", pc);
-            if (ptrace(PTRACE_SINGLESTEP, dbg->pid_fils, NULL, NULL) == -1)
-            {
-                perror("singlestep failed");
-                return;
-            }
-
-            int status;
-            waitpid(dbg->pid_fils, &status, 0);
-            if (WIFSTOPPED(status) && WSTOPSIG(status) != SIGTRAP)
-            {
-                gerer_signaux(dbg, WSTOPSIG(status));
-            }
-
-            long data = (dbg->points_arret[i].donnee_originale & ~0xFF) | 0xCC;
-            if (ptrace(PTRACE_POKEDATA, dbg->pid_fils, pc, data) == -1)
-            {
-                perror("remise point arret");
-                return;
-            }
-
-            return;
+        case 0x14: return 1;
+        case 0x15: return 2;
+        case 0x16: return element;
+        case 0x17: return 4;
+        case 0x19: case 0x39: return 16;
+        case 0x1B: case 0x3B: return 32;
+        case 0x1D: return vecteur / 2;
+        default: break;
         }
     }
+    else if (ins->carte == 6)
+    {
+        if ((op == 0x11 && ins->evex_pp == 2) || (op == 0x7E
+                                                  && ins->evex_pp == 1))
+            return 2;
+    }
+    return vecteur;
 }
-static void continuer_execution(struct debogueur *dbg)
+
+/* Decode la longueur et la forme d'une instruction x86-64. Seuls les
+ * encodages usuels sont reconnus (pas de 3DNow! ni de XOP) : retourne 0
+ * si l'instruction n'est pas comprise. */
+static int decoder_instruction(const unsigned char *code, size_t max,
+                               struct instruction *ins)
 {
-    if (ptrace(PTRACE_CONT, dbg->pid_fils, NULL, NULL) == -1)
+    size_t i = 0;
+    memset(ins, 0, sizeof(*ins));
+
+    while (i < max)
     {
-        perror("ptrace continue");
-        return;
+        unsigned char p = code[i];
+        if (p == 0x66)
+            ins->operande_16 = 1;
+        else if (p == 0x67)
+            ins->adresse_32 = 1;
+        else if (p == 0x64 || p == 0x65)
+            ins->segment = p - 0x60;
+        else if (p != 0xF0 && p != 0xF2 && p != 0xF3 && p != 0x2E
+                 && p != 0x36 && p != 0x3E && p != 0x26)
+            break;
+        i++;
     }
+    if (i < max && (code[i] & 0xF0) == 0x40)
+        ins->rex = code[i++];
+    if (i >= max)
+        return 0;
 
-    int statut;
-    waitpid(dbg->pid_fils, &statut, 0);
-
-    if (WIFSTOPPED(statut))
+    int vex = 0;
+    if (code[i] == 0xC5 || code[i] == 0xC4)
     {
-        int sig = WSTOPSIG(statut);
-        if (sig == SIGTRAP)
+        /* Les bits R, X et B de VEX sont inverses. */
+        vex = 1;
+        if (i + 1 >= max)
+            return 0;
+        ins->rex = 0x40 | (code[i + 1] & 0x80 ? 0 : 4);
+        if (code[i] == 0xC5)
         {
-            struct user_regs_struct regs;
-            ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &regs);
-            gerer_point_arret(dbg);
+            ins->carte = 2;
+            ins->taille_vecteur = code[i + 1] & 4 ? 32 : 16;
+            i += 2;
         }
         else
         {
-            gerer_signaux(dbg, sig);
+            if (i + 2 >= max)
+                return 0;
+            ins->carte = (code[i + 1] & 0x1F) + 1;
+            ins->rex |= (code[i + 1] & 0x40 ? 0 : 2)
+                | (code[i + 1] & 0x20 ? 0 : 1) | (code[i + 2] & 0x80 ? 8 : 0);
+            ins->taille_vecteur = code[i + 2] & 4 ? 32 : 16;
+            i += 3;
         }
+        if (ins->carte < 2 || ins->carte > 4)
+            return 0;
     }
-    else if (WIFEXITED(statut))
+    else if (code[i] == 0x62)
     {
-        printf("Programme terminé avec le code %d\n", WEXITSTATUS(statut));
+        /* EVEX : 62 P0 P1 P2, avec R, X, B et vvvv inverses comme VEX. */
+        vex = 1;
+        if (i + 3 >= max || (code[i + 1] & 0x08) || !(code[i + 2] & 0x04))
+            return 0;
+        int carte = code[i + 1] & 7;
+        if (carte == 0 || carte == 4 || carte == 7)
+            return 0;
+        ins->carte = carte + 1;
+        ins->rex = 0x40 | (code[i + 1] & 0x80 ? 0 : 4)
+            | (code[i + 1] & 0x40 ? 0 : 2) | (code[i + 1] & 0x20 ? 0 : 1)
+            | (code[i + 2] & 0x80 ? 8 : 0);
+        ins->evex = 1;
+        ins->evex_w = (code[i + 2] & 0x80) != 0;
+        ins->evex_pp = code[i + 2] & 3;
+        ins->evex_b = (code[i + 3] & 0x10) != 0;
+        ins->taille_vecteur = (size_t)16 << ((code[i + 3] >> 5) & 3);
+        if (ins->taille_vecteur > 64)
+            return 0;
+        i += 4;
     }
-}
-
-static void afficher_back_trace(struct debogueur *dbg)
-{
-    struct user_regs_struct regs;
-    if (ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &regs) == -1)
+    else if (code[i] == 0x0F)
     {
-        perror("btrace getregs");
-        return;
+        i++;
+        if (i >= max)
+            return 0;
+        ins->carte = 2;
+        if (code[i] == 0x38 || code[i] == 0x3A)
+        {
+            ins->carte = code[i] == 0x38 ? 3 : 4;
+            i++;
+        }
     }
+    else
+        ins->carte = 1;
+    if (i >= max)
+        return 0;
+    ins->opcode = code[i++];
 
-    unsigned long rbp = regs.rbp;
-    unsigned long rip = regs.rip;
-    int niveau = 0;
-
-    printf("Back Trace:\n");
-
-    printf("#%d  0x%lx", niveau, rip);
-    for (size_t i = 0; i < dbg->elf.nb_symboles; i++)
+    if (ins->carte == 1)
     {
-        if (ELF64_ST_TYPE(dbg->elf.symboles[i].st_info) == STT_FUNC)
+        if (opcode_invalide_1(ins->opcode))
+            return 0;
+        ins->a_modrm = a_modrm_1(ins->opcode);
+    }
+    else if (ins->carte == 2)
+    {
+        if (!vex && opcode_invalide_2(ins->opcode))
+            return 0;
+        ins->a_modrm = vex ? ins->opcode != 0x77 : a_modrm_2(ins->opcode);
+    }
+    else
+        ins->a_modrm = 1;
+
+    if (ins->a_modrm)
+    {
+        if (i >= max)
+            return 0;
+        ins->modrm = code[i++];
+        int mod = ins->modrm >> 6;
+        int rm = ins->modrm & 7;
+        if (mod != 3 && rm == 4)
         {
-            unsigned long debut = dbg->elf.symboles[i].st_value;
-            unsigned long fin = debut + dbg->elf.symboles[i].st_size;
-            if (rip >= debut && rip < fin)
+            if (i >= max)
+                return 0;
+            ins->a_sib = 1;
+            ins->sib = code[i++];
+        }
+        if (mod == 1)
+            ins->taille_deplacement = 1;
+        else if (mod == 2)
+            ins->taille_deplacement = 4;
+        else if (mod == 0 && rm == 5)
+        {
+            ins->taille_deplacement = 4;
+            ins->rip_relatif = 1;
+        }
+        else if (mod == 0 && ins->a_sib && (ins->sib & 7) == 5)
+            ins->taille_deplacement = 4;
+        ins->pos_deplacement = i;
+        i += ins->taille_deplacement;
+    }
+    if (ins->evex && ins->a_modrm && (ins->modrm >> 6) == 3 && ins->evex_b)
+    {
+        /* Avec un registre en operande, b choisit l'arrondi et L'L ne
+         * donne plus la longueur du vecteur. */
+        ins->taille_vecteur = 64;
+        ins->evex_b = 0;
+    }
+    else if (!vex)
+        ins->taille_vecteur = 16;
+
+    if (ins->carte == 1)
+    {
+        ins->taille_immediat = taille_immediat_1(ins);
+        unsigned char op = ins->opcode;
+        if ((op >= 0x70 && op <= 0x7F) || (op >= 0xE0 && op <= 0xE3)
+            || op == 0xEB)
+            ins->saut_relatif = 1;
+        else if (op == 0xE8 || op == 0xE9)
+            ins->saut_relatif = 4;
+    }
+    else if (ins->carte == 2)
+    {
+        ins->taille_immediat = vex ? (ins->opcode >= 0x70
+                                      && ins->opcode <= 0x73)
+                                       || ins->opcode == 0xC2
+                                       || ins->opcode == 0xC4
+                                       || ins->opcode == 0xC5
+                                       || ins->opcode == 0xC6
+                                   : taille_immediat_2(ins->opcode);
+        if (!vex && ins->opcode >= 0x80 && ins->opcode <= 0x8F)
+            ins->saut_relatif = 4;
+    }
+    else if (ins->carte == 4)
+        ins->taille_immediat = 1;
+    ins->pos_immediat = i;
+    i += ins->taille_immediat;
+    ins->vex = vex;
+
+    if (i > max || i > 15)
+        return 0;
+    ins->longueur = i;
+    return 1;
+}
+
+struct cible_ecriture
+{
+    unsigned long adresse;
+    size_t taille;
+};
+
+/* Registres generaux dans l'ordre de l'encodage x86-64. */
+static unsigned long long valeur_registre(const struct user_regs_struct *regs,
+                                          int numero)
+{
+    switch (numero)
+    {
+    case 0: return regs->rax;
+    case 1: return regs->rcx;
+    case 2: return regs->rdx;
+    case 3: return regs->rbx;
+    case 4: return regs->rsp;
+    case 5: return regs->rbp;
+    case 6: return regs->rsi;
+    case 7: return regs->rdi;
+    case 8: return regs->r8;
+    case 9: return regs->r9;
+    case 10: return regs->r10;
+    case 11: return regs->r11;
+    case 12: return regs->r12;
+    case 13: return regs->r13;
+    case 14: return regs->r14;
+    default: return regs->r15;
+    }
+}
+
+static unsigned long adresse_operande(const struct instruction *ins,
+                                      const unsigned char *code,
+                                      const struct user_regs_struct *regs)
+{
+    long deplacement = 0;
+    if (ins->taille_deplacement == 1)
+    {
+        deplacement = (signed char)code[ins->pos_deplacement];
+        if (ins->evex)
+            deplacement *= (long)facteur_deplacement_evex(ins);
+    }
+    else if (ins->taille_deplacement == 4)
+    {
+        int32_t d;
+        memcpy(&d, code + ins->pos_deplacement, 4);
+        deplacement = d;
+    }
+
+    unsigned long adresse;
+    if (ins->rip_relatif)
+        adresse = regs->rip + ins->longueur + deplacement;
+    else
+    {
+        int mod = ins->modrm >> 6;
+        int base = (ins->modrm & 7) | (ins->rex & 1) << 3;
+        adresse = deplacement;
+        if (ins->a_sib)
+        {
+            int index = ((ins->sib >> 3) & 7) | (ins->rex & 2) << 2;
+            base = (ins->sib & 7) | (ins->rex & 1) << 3;
+            if (index != 4)
+                adresse += valeur_registre(regs, index) << (ins->sib >> 6);
+            if (mod == 0 && (ins->sib & 7) == 5)
+                base = -1;
+        }
+        if (base != -1)
+            adresse += valeur_registre(regs, base);
+    }
+    if (ins->adresse_32)
+        adresse &= 0xFFFFFFFFUL;
+    if (ins->segment == 4)
+        adresse += regs->fs_base;
+    else if (ins->segment == 5)
+        adresse += regs->gs_base;
+    return adresse;
+}
+
+/* Taille de l'operande memoire. Dans le doute la taille est majoree :
+ * sauvegarder des octets inchanges est sans effet a la restauration. */
+static size_t taille_operande_memoire(const struct instruction *ins)
+{
+    unsigned char op = ins->opcode;
+    int reg = (ins->modrm >> 3) & 7;
+    size_t taille = (ins->rex & 8) ? 8 : ins->operande_16 ? 2 : 4;
+
+    if (ins->carte == 1)
+    {
+        if (op == 0x8D)
+            return 0;
+        if ((op < 0x40 && (op & 1) == 0) || op == 0x80 || op == 0x84
+            || op == 0x86 || op == 0x88 || op == 0x8A || op == 0xC0
+            || op == 0xC6 || op == 0xD0 || op == 0xD2 || op == 0xF6
+            || op == 0xFE)
+            return 1;
+        if (op == 0x8C)
+            return 2;
+        if (op == 0x8F || op == 0xFF)
+            return 8;
+        if (op >= 0xD8 && op <= 0xDF)
+        {
+            if ((op == 0xD9 || op == 0xDD) && reg == 6)
+                return 108;
+            return reg == 7 && (op == 0xD9 || op == 0xDD) ? 2 : 10;
+        }
+        return taille;
+    }
+    if (ins->carte == 2 && !ins->vex)
+    {
+        if ((op >= 0x18 && op <= 0x1F) || op == 0x0D)
+            return 0;
+        if (op == 0xAE)
+            return reg == 0 ? 512 : (reg == 4 || reg == 6) ? TAILLE_PAGE : 4;
+        if (op == 0xC7)
+            return (ins->rex & 8) ? 16 : 8;
+        if (op == 0xB0 || op == 0xC0 || (op >= 0x90 && op <= 0x9F))
+            return 1;
+        if ((op >= 0xA3 && op <= 0xAD) || (op >= 0xB1 && op <= 0xBB)
+            || op == 0xC1 || op == 0xC3)
+            return taille;
+    }
+    return ins->taille_vecteur;
+}
+
+/* Les scatter AVX-512 ecrivent a une adresse par element du vecteur
+ * d'index : leurs cibles ne se resument pas a une zone. */
+static int ecriture_dispersee(const struct instruction *ins)
+{
+    return ins->evex && ins->carte == 3 && ins->opcode >= 0xA0
+        && ins->opcode <= 0xA3;
+}
+
+/* Zones memoire que l'instruction peut ecrire : son operande memoire, la
+ * pile pour push et call, et [rdi] pour stos et movs (une iteration par
+ * pas en mode pas a pas). */
+static size_t cibles_ecriture(const struct instruction *ins,
+                              const unsigned char *code,
+                              const struct user_regs_struct *regs,
+                              struct cible_ecriture *cibles)
+{
+    size_t n = 0;
+    unsigned char op = ins->opcode;
+    int reg = (ins->modrm >> 3) & 7;
+
+    if (ins->a_modrm && (ins->modrm >> 6) != 3)
+    {
+        size_t taille = taille_operande_memoire(ins);
+        if (taille)
+        {
+            cibles[n].adresse = adresse_operande(ins, code, regs);
+            cibles[n++].taille = taille;
+        }
+    }
+
+    if (ins->carte == 1)
+    {
+        if ((op >= 0x50 && op <= 0x57) || op == 0x68 || op == 0x6A
+            || op == 0x9C || op == 0xE8 || (op == 0xFF && reg >= 2 && reg <= 6
+                                            && reg != 4 && reg != 5))
+        {
+            cibles[n].adresse = regs->rsp - 8;
+            cibles[n++].taille = 8;
+        }
+        else if (op == 0xC8)
+        {
+            size_t niveau = code[ins->pos_immediat + 2] & 0x1F;
+            cibles[n].adresse = regs->rsp - 8 * (niveau + 1);
+            cibles[n++].taille = 8 * (niveau + 1);
+        }
+        else if (op == 0xA4 || op == 0xA5 || op == 0xAA || op == 0xAB)
+        {
+            cibles[n].adresse =
+                ins->adresse_32 ? regs->rdi & 0xFFFFFFFFUL : regs->rdi;
+            cibles[n++].taille = (op & 1) == 0 ? 1
+                : (ins->rex & 8)               ? 8
+                : ins->operande_16             ? 2
+                                               : 4;
+        }
+    }
+    else if (ins->carte == 2 && !ins->vex && (op == 0xA0 || op == 0xA8))
+    {
+        cibles[n].adresse = regs->rsp - 8;
+        cibles[n++].taille = 8;
+    }
+    return n;
+}
+
+static int ajouter_journal(struct enregistrement *enr, const void *donnees,
+                           size_t taille)
+{
+    if (enr->taille + taille > enr->capacite)
+    {
+        size_t capacite = enr->capacite ? enr->capacite : 1 << 16;
+        while (enr->taille + taille > capacite)
+            capacite *= 2;
+        unsigned char *journal = realloc(enr->journal, capacite);
+        if (!journal)
+            return 0;
+        enr->journal = journal;
+        enr->capacite = capacite;
+    }
+    memcpy(enr->journal + enr->taille, donnees, taille);
+    enr->taille += taille;
+    return 1;
+}
+
+/* Chaque enregistrement est encadre par sa longueur sur 32 bits pour
+ * pouvoir parcourir le journal dans les deux sens. */
+static int terminer_entree(struct enregistrement *enr)
+{
+    uint32_t longueur =
+        (uint32_t)(enr->taille - enr->debut_entree + sizeof(uint32_t));
+    memcpy(enr->journal + enr->debut_entree, &longueur, sizeof(longueur));
+    return ajouter_journal(enr, &longueur, sizeof(longueur));
+}
+
+static int commencer_entree(struct enregistrement *enr, unsigned char type)
+{
+    uint32_t longueur = 0;
+    enr->debut_entree = enr->taille;
+    return ajouter_journal(enr, &longueur, sizeof(longueur))
+        && ajouter_journal(enr, &type, 1);
+}
+
+static int ajouter_point_reprise(struct enregistrement *enr,
+                                 const struct user_regs_struct *regs)
+{
+    if (!commencer_entree(enr, ENTREE_POINT_REPRISE)
+        || !ajouter_journal(enr, regs, sizeof(*regs))
+        || !terminer_entree(enr))
+        return 0;
+    enr->pas_depuis_reprise = 0;
+    return 1;
+}
+
+/* Au-dela de la taille maximale, le debut du journal est abandonne
+ * jusqu'a un point de reprise situe au-dela du premier quart. */
+static void limiter_journal(struct enregistrement *enr)
+{
+    if (enr->taille <= TAILLE_MAX_ENREGISTREMENT)
+        return;
+
+    size_t pos = 0;
+    while (pos < enr->taille)
+    {
+        uint32_t longueur;
+        memcpy(&longueur, enr->journal + pos, sizeof(longueur));
+        unsigned char type = enr->journal[pos + sizeof(longueur)];
+        if (pos >= enr->taille / 4 && type == ENTREE_POINT_REPRISE)
+            break;
+        if (type == ENTREE_PAS)
+            enr->nb_pas--;
+        pos += longueur;
+    }
+    memmove(enr->journal, enr->journal + pos, enr->taille - pos);
+    enr->taille -= pos;
+}
+
+static void arreter_enregistrement(struct debogueur *dbg)
+{
+    struct enregistrement *enr = &dbg->enregistrement;
+    free(enr->journal);
+    memset(enr, 0, sizeof(*enr));
+}
+
+/* Le journal n'a pas pu grandir : l'entree en cours est retiree et
+ * l'enregistrement s'arrete. */
+static void abandonner_enregistrement(struct debogueur *dbg)
+{
+    struct enregistrement *enr = &dbg->enregistrement;
+    enr->taille = enr->debut_entree;
+    echouer(dbg, "Mémoire insuffisante : enregistrement arrêté\n");
+    arreter_enregistrement(dbg);
+}
+
+static int demarrer_enregistrement(struct debogueur *dbg)
+{
+    struct enregistrement *enr = &dbg->enregistrement;
+    struct user_regs_struct regs;
+    if (ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &regs) == -1)
+    {
+        echouer_systeme(dbg, "record getregs");
+        return 0;
+    }
+    enr->taille = 0;
+    enr->nb_pas = 0;
+    enr->actif = 1;
+    if (!ajouter_point_reprise(enr, &regs))
+    {
+        abandonner_enregistrement(dbg);
+        return 0;
+    }
+    return 1;
+}
+
+/* Avant le pas : ouvre l'entree et y copie les pre-images des zones que
+ * l'instruction va ecrire. */
+static void enregistrer_avant_pas(struct debogueur *dbg,
+                                  struct user_regs_struct *regs)
+{
+    struct enregistrement *enr = &dbg->enregistrement;
+    if (ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, regs) == -1)
+    {
+        echouer_systeme(dbg, "record getregs");
+        arreter_enregistrement(dbg);
+        return;
+    }
+
+    unsigned char code[TAILLE_LECTURE_CODE];
+    struct instruction ins;
+    struct cible_ecriture cibles[3];
+    /* Sans pre-image, le retour arriere restaurerait une memoire fausse :
+     * l'enregistrement s'arrete plutot que de journaliser un pas vide. */
+    size_t taille_code = lire_code(dbg, regs->rip, code, sizeof(code));
+    if (!taille_code || !decoder_instruction(code, taille_code, &ins)
+        || ecriture_dispersee(&ins))
+    {
+        echouer(dbg,
+                "Instruction non reconnue à 0x%llx : enregistrement arrêté\n",
+                regs->rip);
+        arreter_enregistrement(dbg);
+        return;
+    }
+    size_t nb_cibles = cibles_ecriture(&ins, code, regs, cibles);
+
+    unsigned char nb = 0;
+    size_t pos_nb = enr->taille + sizeof(uint32_t) + 1;
+    if (!commencer_entree(enr, ENTREE_PAS) || !ajouter_journal(enr, &nb, 1))
+    {
+        abandonner_enregistrement(dbg);
+        return;
+    }
+    for (size_t i = 0; i < nb_cibles; i++)
+    {
+        unsigned char pre_image[TAILLE_PAGE];
+        uint16_t taille = (uint16_t)cibles[i].taille;
+        if (taille > TAILLE_PAGE)
+            taille = TAILLE_PAGE;
+        if (!lire_memoire(dbg, cibles[i].adresse, pre_image, taille))
+        {
+            /* L'operande majore peut deborder sur une page absente. */
+            unsigned long fin_page =
+                (cibles[i].adresse | (TAILLE_PAGE - 1)) + 1;
+            taille = (uint16_t)(fin_page - cibles[i].adresse);
+            if (taille >= cibles[i].taille
+                || !lire_memoire(dbg, cibles[i].adresse, pre_image, taille))
+                continue;
+        }
+        if (!ajouter_journal(enr, &cibles[i].adresse,
+                             sizeof(cibles[i].adresse))
+            || !ajouter_journal(enr, &taille, sizeof(taille))
+            || !ajouter_journal(enr, pre_image, taille))
+        {
+            abandonner_enregistrement(dbg);
+            return;
+        }
+        nb++;
+    }
+    enr->journal[pos_nb] = nb;
+}
+
+/* Apres le pas : ajoute les anciennes valeurs des registres modifies. */
+static void enregistrer_apres_pas(struct debogueur *dbg,
+                                  const struct user_regs_struct *avant)
+{
+    struct enregistrement *enr = &dbg->enregistrement;
+    struct user_regs_struct apres;
+    if (ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &apres) == -1)
+    {
+        echouer_systeme(dbg, "record getregs");
+        arreter_enregistrement(dbg);
+        return;
+    }
+
+    unsigned long long anciens[NB_REGISTRES];
+    unsigned long long nouveaux[NB_REGISTRES];
+    memcpy(anciens, avant, sizeof(anciens));
+    memcpy(nouveaux, &apres, sizeof(nouveaux));
+
+    unsigned char nb = 0;
+    size_t pos_nb = enr->taille;
+    int ok = ajouter_journal(enr, &nb, 1);
+    for (unsigned char r = 0; r < NB_REGISTRES && ok; r++)
+    {
+        if (r == INDICE_ORIG_RAX || anciens[r] == nouveaux[r])
+            continue;
+        ok = ajouter_journal(enr, &r, 1)
+            && ajouter_journal(enr, &anciens[r], sizeof(anciens[r]));
+        nb++;
+    }
+    if (ok)
+    {
+        enr->journal[pos_nb] = nb;
+        ok = terminer_entree(enr);
+    }
+    if (!ok)
+    {
+        abandonner_enregistrement(dbg);
+        return;
+    }
+    enr->nb_pas++;
+
+    if (++enr->pas_depuis_reprise >= INTERVALLE_POINTS_REPRISE)
+    {
+        if (!ajouter_point_reprise(enr, &apres))
+        {
+            abandonner_enregistrement(dbg);
+            return;
+        }
+    }
+    limiter_journal(enr);
+}
+
+/* Defait la derniere entree du journal. Retourne 0 si le journal est
+ * vide. */
+static int defaire_pas(struct debogueur *dbg)
+{
+    struct enregistrement *enr = &dbg->enregistrement;
+    while (enr->taille > 0)
+    {
+        uint32_t longueur;
+        memcpy(&longueur, enr->journal + enr->taille - sizeof(longueur),
+               sizeof(longueur));
+        unsigned char *entree = enr->journal + enr->taille - longueur;
+        unsigned char *p = entree + sizeof(longueur);
+        unsigned char type = *p++;
+
+        if (type == ENTREE_POINT_REPRISE)
+        {
+            /* Le premier point de reprise reste l'origine du journal. */
+            if (enr->taille == longueur)
+                return 0;
+            struct user_regs_struct regs;
+            memcpy(&regs, p, sizeof(regs));
+            ptrace(PTRACE_SETREGS, dbg->pid_fils, NULL, &regs);
+            enr->taille -= longueur;
+            continue;
+        }
+
+        /* Pre-images restaurees dans l'ordre inverse de leur capture. */
+        unsigned char nb_zones = *p++;
+        unsigned char *zones[3];
+        for (unsigned char i = 0; i < nb_zones && i < 3; i++)
+        {
+            zones[i] = p;
+            uint16_t taille;
+            memcpy(&taille, p + sizeof(unsigned long), sizeof(taille));
+            p += sizeof(unsigned long) + sizeof(taille) + taille;
+        }
+        for (int i = nb_zones - 1; i >= 0; i--)
+        {
+            unsigned long adresse;
+            uint16_t taille;
+            memcpy(&adresse, zones[i], sizeof(adresse));
+            memcpy(&taille, zones[i] + sizeof(adresse), sizeof(taille));
+            ecrire_memoire(dbg, adresse,
+                           zones[i] + sizeof(adresse) + sizeof(taille), taille);
+        }
+
+        struct user_regs_struct regs;
+        if (ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &regs) == -1)
+            return 0;
+        unsigned long long valeurs[NB_REGISTRES];
+        memcpy(valeurs, &regs, sizeof(valeurs));
+        unsigned char nb_registres = *p++;
+        for (unsigned char i = 0; i < nb_registres; i++)
+        {
+            unsigned char r = *p++;
+            memcpy(&valeurs[r], p, sizeof(valeurs[r]));
+            p += sizeof(valeurs[r]);
+        }
+        memcpy(&regs, valeurs, sizeof(regs));
+        if (ptrace(PTRACE_SETREGS, dbg->pid_fils, NULL, &regs) == -1)
+        {
+            echouer_systeme(dbg, "reverse setregs");
+            return 0;
+        }
+
+        enr->taille -= longueur;
+        enr->nb_pas--;
+        if (enr->pas_depuis_reprise > 0)
+            enr->pas_depuis_reprise--;
+        return 1;
+    }
+    return 0;
+}
+
+static void afficher_position(struct debogueur *dbg)
+{
+    struct user_regs_struct regs;
+    if (ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &regs) != -1)
+        printf("Programme arrêté à 0x%llx\n", regs.rip);
+}
+
+static void reculer(struct debogueur *dbg, int nombre_pas)
+{
+    if (!dbg->enregistrement.actif)
+    {
+        echouer(dbg, "Enregistrement inactif\n");
+        return;
+    }
+    for (int i = 0; i < nombre_pas; i++)
+    {
+        if (!defaire_pas(dbg))
+        {
+            printf("Début de l'enregistrement atteint\n");
+            break;
+        }
+    }
+    afficher_position(dbg);
+}
+
+static void reculer_jusqu_au_point_arret(struct debogueur *dbg)
+{
+    if (!dbg->enregistrement.actif)
+    {
+        echouer(dbg, "Enregistrement inactif\n");
+        return;
+    }
+    while (defaire_pas(dbg))
+    {
+        struct user_regs_struct regs;
+        if (ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &regs) == -1)
+            return;
+        for (int i = 0; i < dbg->nb_points_arret; i++)
+        {
+            if (dbg->points_arret[i].actif
+                && dbg->points_arret[i].adresse == regs.rip)
+            {
+                printf("Breakpoint at 0x%llx\n", regs.rip);
+                return;
+            }
+        }
+    }
+    printf("Début de l'enregistrement atteint\n");
+    afficher_position(dbg);
+}
+
+static void etape_suivante(struct debogueur *dbg, int nombre_pas)
+{
+    struct enregistrement *enr = &dbg->enregistrement;
+    for (int i = 0; i < nombre_pas; i++)
+    {
+        struct user_regs_struct avant;
+        if (enr->actif)
+            enregistrer_avant_pas(dbg, &avant);
+        if (ptrace(PTRACE_SINGLESTEP, dbg->pid_fils, NULL, NULL) == -1)
+        {
+            echouer_systeme(dbg, "ptrace singlestep");
+            if (enr->actif)
+                enr->taille = enr->debut_entree;
+            return;
+        }
+        int statut;
+        waitpid(dbg->pid_fils, &statut, 0);
+
+        if (enr->actif)
+        {
+            if (WIFSTOPPED(statut) && WSTOPSIG(statut) == SIGTRAP)
+                enregistrer_apres_pas(dbg, &avant);
+            else if (WIFSTOPPED(statut))
+                enr->taille = enr->debut_entree;
+            else
+                arreter_enregistrement(dbg);
+        }
+
+        if (WIFSTOPPED(statut))
+        {
+            if (WSTOPSIG(statut) == SIGTRAP)
+            {
+                struct user_regs_struct regs;
+                if (ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &regs) != -1)
+                {
+                    printf("Programme arrêté à 0x%llx\n", regs.rip);
+                }
+            }
+            else
             {
-                printf(" dans %s", dbg->elf.table_symboles + dbg->elf.symboles[i].st_name);
+                gerer_signaux(dbg, WSTOPSIG(statut));
                 break;
             }
         }
+        else if (WIFEXITED(statut))
+        {
+            printf("Programme terminé avec le code %d\n", WEXITSTATUS(statut));
+            break;
+        }
+    }
+}
+
+static Elf64_Sym *chercher_symbole(struct donnees_elf *elf,
+                                   unsigned long addr)
+{
+    for (size_t i = 0; i < elf->nb_symboles; i++)
+    {
+        Elf64_Sym *sym = &elf->symboles[i];
+        int type = ELF64_ST_TYPE(sym->st_info);
+        if ((type != STT_FUNC && type != STT_OBJECT) || !sym->st_name)
+            continue;
+        if (addr >= sym->st_value && addr < sym->st_value + sym->st_size)
+            return sym;
+    }
+    return NULL;
+}
+
+/* Nom affiche d'un symbole : demangle une seule fois avec -C, puis
+ * relu dans la table indexee par son decalage dans .strtab. */
+static const char *nom_symbole(struct debogueur *dbg, Elf64_Sym *sym)
+{
+    const char *nom = dbg->elf.table_symboles + sym->st_name;
+    if (!dbg->demangle)
+        return nom;
+    return nom_demangle(&dbg->noms, sym->st_name, nom);
+}
+
+static const char *symbole_contenant(struct debogueur *dbg,
+                                     unsigned long addr,
+                                     unsigned long *decalage)
+{
+    Elf64_Sym *sym = chercher_symbole(&dbg->elf, addr);
+    if (!sym)
+        return NULL;
+    *decalage = addr - sym->st_value;
+    return nom_symbole(dbg, sym);
+}
+
+static unsigned long recuperer_adresse_symbole(struct debogueur *dbg,
+                                               const char *symbole)
+{
+    struct user_regs_struct regs;
+    if (strcmp(symbole, "$rip") == 0)
+    {
+        if (ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &regs) != -1)
+            return regs.rip;
+    }
+    if (strcmp(symbole, "$rsp") == 0)
+    {
+        if (ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &regs) != -1)
+            return regs.rsp;
+    }
+    if (!dbg->elf.symboles || !dbg->elf.table_symboles)
+        return (unsigned long)-1;
+    /* Un nom qualifie (ns::f) est compare au nom demangle sans sa liste
+     * de parametres. */
+    int qualifie = strstr(symbole, "::") != NULL;
+    size_t longueur = strlen(symbole);
+    for (size_t i = 0; i < dbg->elf.nb_symboles; i++)
+    {
+        Elf64_Sym *sym = &dbg->elf.symboles[i];
+        if (!sym->st_name || ELF64_ST_TYPE(sym->st_info) != STT_FUNC)
+            continue;
+        const char *nom = dbg->elf.table_symboles + sym->st_name;
+        if (strcmp(nom, symbole) == 0)
+            return sym->st_value;
+        if (qualifie)
+        {
+            nom = nom_demangle(&dbg->noms, sym->st_name, nom);
+            if (strncmp(nom, symbole, longueur) == 0
+                && (nom[longueur] == '\0' || nom[longueur] == '('))
+                return sym->st_value;
+        }
+    }
+    return (unsigned long)-1;
+}
+
+static int chevauche_point_arret(struct debogueur *dbg, unsigned long debut,
+                                 size_t taille)
+{
+    for (int i = 0; i < dbg->nb_points_arret; i++)
+    {
+        if (dbg->points_arret[i].adresse >= debut
+            && dbg->points_arret[i].adresse < debut + taille)
+            return 1;
+    }
+    return 0;
+}
+
+static int chevauche_point_trace(struct debogueur *dbg, unsigned long debut,
+                                 size_t taille)
+{
+    for (int i = 0; i < dbg->nb_points_trace; i++)
+    {
+        struct point_trace *tp = &dbg->points_trace[i];
+        if (debut < tp->adresse + tp->taille_deplacee
+            && tp->adresse < debut + taille)
+            return 1;
+    }
+    return 0;
+}
+
+/* Ecrit un seul octet en relisant le mot courant : le mot sauve a la
+ * pose d'un point d'arret peut etre perime si un point de trace a depuis
+ * modifie les 7 octets suivants. */
+static int ecrire_octet(struct debogueur *dbg, unsigned long addr,
+                        unsigned char octet)
+{
+    errno = 0;
+    long mot = ptrace(PTRACE_PEEKDATA, dbg->pid_fils, addr, NULL);
+    if (errno != 0)
+        return -1;
+    mot = (mot & ~0xFFL) | octet;
+    return (int)ptrace(PTRACE_POKEDATA, dbg->pid_fils, addr, mot);
+}
+
+static void restaurer_point_arret(struct debogueur *dbg, struct point_arret *bp)
+{
+    if (ecrire_octet(dbg, bp->adresse, bp->donnee_originale & 0xFF) == -1)
+        echouer_systeme(dbg, "restauration point arret");
+}
+
+static int ajouter_point_arret(struct debogueur *dbg, unsigned long addr)
+{
+    if (addr == 0 || addr == (unsigned long)-1)
+    {
+        echouer(dbg, "Adresse invalide pour le point d'arrêt\n");
+        return 0;
+    }
+
+    if (dbg->nb_points_arret >= MAX_POINTS_ARRET)
+    {
+        echouer(dbg, "Nombre maximum de points d'arrêt atteint\n");
+        return 0;
+    }
+
+    if (chevauche_point_trace(dbg, addr, 1))
+    {
+        echouer(dbg, "Un point de trace occupe déjà cette adresse\n");
+        return 0;
+    }
+
+    errno = 0;
+    long donnee = ptrace(PTRACE_PEEKDATA, dbg->pid_fils, addr, NULL);
+    if (errno != 0)
+    {
+        echouer_systeme(dbg, "ptrace peek");
+        return 0;
+    }
+
+    long int3 = (donnee & ~0xFF) | 0xCC;
+    if (ptrace(PTRACE_POKEDATA, dbg->pid_fils, addr, int3) == -1)
+    {
+        echouer_systeme(dbg, "ptrace poke");
+        return 0;
+    }
+
+    struct point_arret *bp = &dbg->points_arret[dbg->nb_points_arret++];
+    bp->numero = dbg->nb_points_arret;
+    bp->adresse = addr;
+    bp->donnee_originale = donnee;
+    bp->actif = 1;
+
+    return 1;
+}
+
+static int gerer_point_arret(struct debogueur *dbg)
+{
+    struct user_regs_struct regs;
+    if (ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &regs) == -1)
+    {
+        echouer_systeme(dbg, "getregs failed");
+        return -1;
+    }
+
+    unsigned long pc = regs.rip - 1;
+
+    for (int i = 0; i < dbg->nb_points_arret; i++)
+    {
+        if (dbg->points_arret[i].adresse == pc && dbg->points_arret[i].actif)
+        {
+            if (ecrire_octet(dbg, pc,
+                             dbg->points_arret[i].donnee_originale & 0xFF)
+                == -1)
+            {
+                echouer_systeme(dbg, "restauration instruction");
+                return -1;
+            }
+
+            regs.rip = pc;
+            if (ptrace(PTRACE_SETREGS, dbg->pid_fils, NULL, &regs) == -1)
+            {
+                echouer_systeme(dbg, "setregs failed");
+                return -1;
+            }
+
+            printf("Breakpoint at 0x%lx\n", pc);
+            if (ptrace(PTRACE_SINGLESTEP, dbg->pid_fils, NULL, NULL) == -1)
+            {
+                echouer_systeme(dbg, "singlestep failed");
+                return -1;
+            }
+
+            int status;
+            waitpid(dbg->pid_fils, &status, 0);
+            if (WIFSTOPPED(status) && WSTOPSIG(status) != SIGTRAP)
+            {
+                gerer_signaux(dbg, WSTOPSIG(status));
+            }
+
+            if (ecrire_octet(dbg, pc, 0xCC) == -1)
+            {
+                echouer_systeme(dbg, "remise point arret");
+                return -1;
+            }
+
+            return i;
+        }
+    }
+    return -1;
+}
+static int executer_commandes_point_arret(struct debogueur *dbg, int indice);
+
+/* L'execution libre n'est pas enregistree : apres une reprise par
+ * PTRACE_CONT, le journal repart de l'arret suivant. */
+static void reprendre_enregistrement(struct debogueur *dbg, int statut)
+{
+    if (!dbg->enregistrement.actif)
+        return;
+    if (WIFSTOPPED(statut))
+    {
+        printf("Journal d'enregistrement réinitialisé\n");
+        demarrer_enregistrement(dbg);
+    }
+    else
+        arreter_enregistrement(dbg);
+}
+
+static void continuer_execution(struct debogueur *dbg)
+{
+    /* Les points d'arret munis de commandes relancent l'execution sans
+     * revenir a l'invite. */
+    int reprendre = 1;
+    while (reprendre)
+    {
+        reprendre = 0;
+        if (ptrace(PTRACE_CONT, dbg->pid_fils, NULL, NULL) == -1)
+        {
+            echouer_systeme(dbg, "ptrace continue");
+            return;
+        }
+
+        int statut;
+        waitpid(dbg->pid_fils, &statut, 0);
+        reprendre_enregistrement(dbg, statut);
+
+        if (WIFSTOPPED(statut))
+        {
+            int sig = WSTOPSIG(statut);
+            if (sig == SIGTRAP)
+            {
+                int indice = gerer_point_arret(dbg);
+                reprendre = indice >= 0
+                    && executer_commandes_point_arret(dbg, indice);
+            }
+            else
+            {
+                gerer_signaux(dbg, sig);
+            }
+        }
+        else if (WIFEXITED(statut))
+        {
+            printf("Programme terminé avec le code %d\n", WEXITSTATUS(statut));
+        }
+    }
+}
+
+static int lire_uleb(const unsigned char **p, const unsigned char *fin,
+                     unsigned long *valeur)
+{
+    unsigned long resultat = 0;
+    int decalage = 0;
+    while (*p < fin)
+    {
+        unsigned char octet = *(*p)++;
+        if (decalage < 64)
+            resultat |= (unsigned long)(octet & 0x7F) << decalage;
+        decalage += 7;
+        if (!(octet & 0x80))
+        {
+            *valeur = resultat;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int lire_sleb(const unsigned char **p, const unsigned char *fin,
+                     long *valeur)
+{
+    unsigned long resultat = 0;
+    int decalage = 0;
+    unsigned char octet = 0;
+    while (*p < fin)
+    {
+        octet = *(*p)++;
+        if (decalage < 64)
+            resultat |= (unsigned long)(octet & 0x7F) << decalage;
+        decalage += 7;
+        if (!(octet & 0x80))
+        {
+            if (decalage < 64 && (octet & 0x40))
+                resultat |= ~0UL << decalage;
+            *valeur = (long)resultat;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static unsigned long lire_fixe(const unsigned char **p, size_t taille)
+{
+    unsigned long valeur = 0;
+    memcpy(&valeur, *p, taille);
+    *p += taille;
+    return valeur;
+}
+
+static const char *nom_de_base(const char *chemin)
+{
+    const char *barre = strrchr(chemin, '/');
+    return barre ? barre + 1 : chemin;
+}
+
+/* Lit un attribut d'entree de repertoire ou de fichier (DWARF 5). Seules
+ * les chaines sont conservees dans *chaine. */
+static int lire_forme(struct donnees_elf *elf, const unsigned char **p,
+                      const unsigned char *fin, unsigned long forme,
+                      int format_64, const char **chaine)
+{
+    unsigned long valeur;
+    size_t taille_decalage = format_64 ? 8 : 4;
+    *chaine = NULL;
+    switch (forme)
+    {
+    case DW_FORM_string:
+        *chaine = (const char *)*p;
+        *p += strnlen(*chaine, (size_t)(fin - *p)) + 1;
+        return *p <= fin;
+    case DW_FORM_line_strp:
+    case DW_FORM_strp:
+        if (*p + taille_decalage > fin)
+            return 0;
+        valeur = lire_fixe(p, taille_decalage);
+        if (forme == DW_FORM_line_strp && elf->debug_line_str
+            && valeur < elf->taille_debug_line_str)
+            *chaine = elf->debug_line_str + valeur;
+        else if (forme == DW_FORM_strp && elf->debug_str
+                 && valeur < elf->taille_debug_str)
+            *chaine = elf->debug_str + valeur;
+        return 1;
+    case DW_FORM_udata:
+        return lire_uleb(p, fin, &valeur);
+    case DW_FORM_data1:
+        *p += 1;
+        return *p <= fin;
+    case DW_FORM_data2:
+        *p += 2;
+        return *p <= fin;
+    case DW_FORM_data4:
+        *p += 4;
+        return *p <= fin;
+    case DW_FORM_data8:
+        *p += 8;
+        return *p <= fin;
+    case DW_FORM_data16:
+        *p += 16;
+        return *p <= fin;
+    case DW_FORM_block:
+        if (!lire_uleb(p, fin, &valeur))
+            return 0;
+        *p += valeur;
+        return *p <= fin;
+    default:
+        return 0;
+    }
+}
+
+static int ajouter_fichier(struct unite_lignes *u, const char *nom)
+{
+    const char **fichiers =
+        realloc(u->fichiers, (u->nb_fichiers + 1) * sizeof(*fichiers));
+    if (!fichiers)
+        return 0;
+    u->fichiers = fichiers;
+    u->fichiers[u->nb_fichiers++] = nom ? nom_de_base(nom) : NULL;
+    return 1;
+}
+
+/* Table des fichiers DWARF 5 : formats d'entree puis entrees. */
+static int lire_table_v5(struct donnees_elf *elf, struct unite_lignes *u,
+                         const unsigned char **p, const unsigned char *fin,
+                         int format_64, int fichiers)
+{
+    if (*p >= fin)
+        return 0;
+    unsigned char nb_formats = *(*p)++;
+    unsigned long formats[16][2];
+    if (nb_formats > 16)
+        return 0;
+    for (unsigned char f = 0; f < nb_formats; f++)
+    {
+        if (!lire_uleb(p, fin, &formats[f][0])
+            || !lire_uleb(p, fin, &formats[f][1]))
+            return 0;
+    }
+
+    unsigned long nb_entrees;
+    if (!lire_uleb(p, fin, &nb_entrees))
+        return 0;
+    for (unsigned long e = 0; e < nb_entrees; e++)
+    {
+        const char *chemin = NULL;
+        for (unsigned char f = 0; f < nb_formats; f++)
+        {
+            const char *chaine;
+            if (!lire_forme(elf, p, fin, formats[f][1], format_64, &chaine))
+                return 0;
+            if (formats[f][0] == DW_LNCT_path)
+                chemin = chaine;
+        }
+        if (fichiers && !ajouter_fichier(u, chemin))
+            return 0;
+    }
+    return 1;
+}
+
+/* Lit l'en-tete d'une unite de .debug_line : parametres du programme et
+ * table des fichiers, sans decoder le programme. */
+static int lire_entete_lignes(struct donnees_elf *elf,
+                              struct unite_lignes *u,
+                              const unsigned char *p,
+                              const unsigned char *fin_section)
+{
+    memset(u, 0, sizeof(*u));
+    u->entete = p;
+    if (p + 4 > fin_section)
+        return 0;
+    unsigned long longueur = lire_fixe(&p, 4);
+    int format_64 = longueur == 0xFFFFFFFFUL;
+    if (format_64)
+    {
+        if (p + 8 > fin_section)
+            return 0;
+        longueur = lire_fixe(&p, 8);
+    }
+    if (longueur > (unsigned long)(fin_section - p))
+        return 0;
+    u->fin = p + longueur;
+
+    const unsigned char *fin = u->fin;
+    if (p + 2 > fin)
+        return 0;
+    u->version = (int)lire_fixe(&p, 2);
+    if (u->version < 2 || u->version > 5)
+        return 0;
+    if (u->version >= 5)
+        p += 2; /* address_size, segment_selector_size */
+
+    size_t taille_decalage = format_64 ? 8 : 4;
+    if (p + taille_decalage > fin)
+        return 0;
+    unsigned long longueur_entete = lire_fixe(&p, taille_decalage);
+    if (longueur_entete > (unsigned long)(fin - p))
+        return 0;
+    u->programme = p + longueur_entete;
+
+    if (p + 5 > fin)
+        return 0;
+    u->longueur_min_instruction = *p++;
+    if (u->version >= 4)
+        p++; /* maximum_operations_per_instruction */
+    u->stmt_defaut = *p++;
+    u->base_lignes = (signed char)*p++;
+    u->plage_lignes = *p++;
+    u->base_opcodes = *p++;
+    if (u->plage_lignes == 0 || u->base_opcodes == 0
+        || p + u->base_opcodes - 1 > fin)
+        return 0;
+    u->longueurs_opcodes = p;
+    p += u->base_opcodes - 1;
+
+    if (u->version >= 5)
+        return lire_table_v5(elf, u, &p, u->programme, format_64, 0)
+            && lire_table_v5(elf, u, &p, u->programme, format_64, 1);
+
+    /* Avant DWARF 5, les fichiers sont numerotes a partir de 1. */
+    while (p < u->programme && *p)
+        p += strnlen((const char *)p, (size_t)(u->programme - p)) + 1;
+    p++;
+    if (!ajouter_fichier(u, NULL))
+        return 0;
+    while (p < u->programme && *p)
+    {
+        const char *nom = (const char *)p;
+        p += strnlen(nom, (size_t)(u->programme - p)) + 1;
+        unsigned long ignore;
+        if (!lire_uleb(&p, u->programme, &ignore)
+            || !lire_uleb(&p, u->programme, &ignore)
+            || !lire_uleb(&p, u->programme, &ignore)
+            || !ajouter_fichier(u, nom))
+            return 0;
+    }
+    return 1;
+}
+
+/* Lit un attribut d'une entree de .debug_info. Les constantes, adresses et
+ * decalages sont rendus dans *valeur ; les chaines et blocs sont sautes. */
+static int lire_attribut(const unsigned char **p, const unsigned char *fin,
+                         unsigned long forme, long constante,
+                         int version, int format_64, int taille_adresse,
+                         unsigned long *valeur)
+{
+    size_t taille_decalage = format_64 ? 8 : 4;
+    size_t taille;
+    unsigned long longueur;
+    long signe;
+    *valeur = 0;
+    switch (forme)
+    {
+    case DW_FORM_flag_present:
+        return 1;
+    case DW_FORM_implicit_const:
+        *valeur = (unsigned long)constante;
+        return 1;
+    case DW_FORM_addr:
+        taille = (size_t)taille_adresse;
+        break;
+    case DW_FORM_data1:
+    case DW_FORM_flag:
+    case DW_FORM_ref1:
+    case DW_FORM_strx1:
+    case DW_FORM_addrx1:
+        taille = 1;
+        break;
+    case DW_FORM_data2:
+    case DW_FORM_ref2:
+    case DW_FORM_strx2:
+    case DW_FORM_addrx2:
+        taille = 2;
+        break;
+    case DW_FORM_strx3:
+    case DW_FORM_addrx3:
+        taille = 3;
+        break;
+    case DW_FORM_data4:
+    case DW_FORM_ref4:
+    case DW_FORM_ref_sup4:
+    case DW_FORM_strx4:
+    case DW_FORM_addrx4:
+        taille = 4;
+        break;
+    case DW_FORM_data8:
+    case DW_FORM_ref8:
+    case DW_FORM_ref_sig8:
+    case DW_FORM_ref_sup8:
+        taille = 8;
+        break;
+    case DW_FORM_data16:
+        taille = 16;
+        break;
+    case DW_FORM_strp:
+    case DW_FORM_line_strp:
+    case DW_FORM_strp_sup:
+    case DW_FORM_sec_offset:
+        taille = taille_decalage;
+        break;
+    case DW_FORM_ref_addr:
+        /* En DWARF 2, ref_addr a la taille d'une adresse. */
+        taille = version == 2 ? (size_t)taille_adresse : taille_decalage;
+        break;
+    case DW_FORM_udata:
+    case DW_FORM_ref_udata:
+    case DW_FORM_strx:
+    case DW_FORM_addrx:
+    case DW_FORM_loclistx:
+    case DW_FORM_rnglistx:
+        return lire_uleb(p, fin, valeur);
+    case DW_FORM_sdata:
+        if (!lire_sleb(p, fin, &signe))
+            return 0;
+        *valeur = (unsigned long)signe;
+        return 1;
+    case DW_FORM_string:
+        *p += strnlen((const char *)*p, (size_t)(fin - *p)) + 1;
+        return *p <= fin;
+    case DW_FORM_block1:
+    case DW_FORM_block2:
+    case DW_FORM_block4:
+        taille = forme == DW_FORM_block1 ? 1 : forme == DW_FORM_block2 ? 2 : 4;
+        if (taille > (size_t)(fin - *p))
+            return 0;
+        longueur = lire_fixe(p, taille);
+        if (longueur > (unsigned long)(fin - *p))
+            return 0;
+        *p += longueur;
+        return 1;
+    case DW_FORM_block:
+    case DW_FORM_exprloc:
+        if (!lire_uleb(p, fin, &longueur)
+            || longueur > (unsigned long)(fin - *p))
+            return 0;
+        *p += longueur;
+        return 1;
+    case DW_FORM_indirect:
+        if (!lire_uleb(p, fin, &forme) || forme == DW_FORM_indirect
+            || forme == DW_FORM_implicit_const)
+            return 0;
+        return lire_attribut(p, fin, forme, 0, version, format_64,
+                             taille_adresse, valeur);
+    default:
+        return 0;
+    }
+    if (taille > (size_t)(fin - *p))
+        return 0;
+    if (taille > sizeof(*valeur))
+        *p += taille;
+    else
+        *valeur = lire_fixe(p, taille);
+    return 1;
+}
+
+/* Attributs utiles de la premiere entree d'une unite de compilation. */
+struct attributs_unite
+{
+    unsigned long decalage_lignes; /* DW_AT_stmt_list */
+    unsigned long bas;
+    unsigned long haut;
+    int lignes_connues;
+    int plage_connue;
+};
+
+/* Lit l'unite de .debug_info qui commence en *position et avance *position
+ * jusqu'a la suivante. Rend 0 si la section est illisible a cet endroit. */
+static int lire_unite_info(struct donnees_elf *elf,
+                           const unsigned char **position,
+                           struct attributs_unite *attributs)
+{
+    const unsigned char *p = *position;
+    const unsigned char *fin_section = elf->debug_info + elf->taille_debug_info;
+    memset(attributs, 0, sizeof(*attributs));
+    if (p + 4 > fin_section)
+        return 0;
+    unsigned long longueur = lire_fixe(&p, 4);
+    int format_64 = longueur == 0xFFFFFFFFUL;
+    if (format_64)
+    {
+        if (p + 8 > fin_section)
+            return 0;
+        longueur = lire_fixe(&p, 8);
+    }
+    if (longueur > (unsigned long)(fin_section - p))
+        return 0;
+    const unsigned char *fin = p + longueur;
+    *position = fin;
+
+    size_t taille_decalage = format_64 ? 8 : 4;
+    if (p + 2 > fin)
+        return 1;
+    int version = (int)lire_fixe(&p, 2);
+    int type_unite = DW_UT_compile;
+    int taille_adresse;
+    unsigned long decalage_abreviations;
+    if (version >= 5)
+    {
+        if (p + 2 + taille_decalage > fin)
+            return 1;
+        type_unite = *p++;
+        taille_adresse = *p++;
+        decalage_abreviations = lire_fixe(&p, taille_decalage);
+    }
+    else
+    {
+        if (p + taille_decalage + 1 > fin)
+            return 1;
+        decalage_abreviations = lire_fixe(&p, taille_decalage);
+        taille_adresse = *p++;
+    }
+    /* Les unites de type ne decrivent pas de code. */
+    if (version < 2 || version > 5
+        || (type_unite != DW_UT_compile && type_unite != DW_UT_partial)
+        || (taille_adresse != 4 && taille_adresse != 8)
+        || decalage_abreviations >= elf->taille_debug_abbrev)
+        return 1;
+
+    unsigned long code;
+    if (!lire_uleb(&p, fin, &code) || code == 0)
+        return 1;
+
+    /* Recherche de l'abreviation de la premiere entree. */
+    const unsigned char *a = elf->debug_abbrev + decalage_abreviations;
+    const unsigned char *fin_abreviations =
+        elf->debug_abbrev + elf->taille_debug_abbrev;
+    for (;;)
+    {
+        unsigned long numero;
+        unsigned long ignore;
+        if (!lire_uleb(&a, fin_abreviations, &numero) || numero == 0
+            || !lire_uleb(&a, fin_abreviations, &ignore)
+            || a >= fin_abreviations)
+            return 1;
+        a++; /* DW_CHILDREN */
+        if (numero == code)
+            break;
+        for (;;)
+        {
+            unsigned long nom_attribut;
+            unsigned long forme;
+            long constante;
+            if (!lire_uleb(&a, fin_abreviations, &nom_attribut)
+                || !lire_uleb(&a, fin_abreviations, &forme))
+                return 1;
+            if (nom_attribut == 0 && forme == 0)
+                break;
+            if (forme == DW_FORM_implicit_const
+                && !lire_sleb(&a, fin_abreviations, &constante))
+                return 1;
+        }
+    }
+
+    unsigned long forme_haut = 0;
+    int bas_lu = 0;
+    int haut_lu = 0;
+    for (;;)
+    {
+        unsigned long nom_attribut;
+        unsigned long forme;
+        unsigned long valeur;
+        long constante = 0;
+        if (!lire_uleb(&a, fin_abreviations, &nom_attribut)
+            || !lire_uleb(&a, fin_abreviations, &forme))
+            return 1;
+        if (nom_attribut == 0 && forme == 0)
+            break;
+        if (forme == DW_FORM_implicit_const
+            && !lire_sleb(&a, fin_abreviations, &constante))
+            return 1;
+        if (!lire_attribut(&p, fin, forme, constante, version, format_64,
+                           taille_adresse, &valeur))
+            return 1;
+        if (nom_attribut == DW_AT_stmt_list)
+        {
+            attributs->decalage_lignes = valeur;
+            attributs->lignes_connues = 1;
+        }
+        /* Les formes addrx renvoient a .debug_addr, non lue ici. */
+        else if (nom_attribut == DW_AT_low_pc && forme == DW_FORM_addr)
+        {
+            attributs->bas = valeur;
+            bas_lu = 1;
+        }
+        else if (nom_attribut == DW_AT_high_pc)
+        {
+            attributs->haut = valeur;
+            forme_haut = forme;
+            haut_lu = 1;
+        }
+    }
+    if (bas_lu && haut_lu && forme_haut != DW_FORM_addrx
+        && (forme_haut < DW_FORM_addrx1 || forme_haut > DW_FORM_addrx4))
+    {
+        /* Depuis DWARF 4, une constante donne la taille de l'unite. */
+        if (forme_haut != DW_FORM_addr)
+            attributs->haut += attributs->bas;
+        attributs->plage_connue = attributs->haut > attributs->bas;
+    }
+    return 1;
+}
+
+static int ajouter_plage(struct table_lignes *t, unsigned long bas,
+                         unsigned long haut, size_t unite)
+{
+    struct plage_unite *plages =
+        realloc(t->plages, (t->nb_plages + 1) * sizeof(*plages));
+    if (!plages)
+        return 0;
+    t->plages = plages;
+    t->plages[t->nb_plages].bas = bas;
+    t->plages[t->nb_plages].haut = haut;
+    t->plages[t->nb_plages].unite = unite;
+    t->nb_plages++;
+    t->unites[unite].plage_connue = 1;
+    return 1;
+}
+
+static int comparer_plages(const void *a, const void *b)
+{
+    const struct plage_unite *pa = a;
+    const struct plage_unite *pb = b;
+    if (pa->bas != pb->bas)
+        return pa->bas < pb->bas ? -1 : 1;
+    return 0;
+}
+
+/* Unite de .debug_line qui commence au decalage donne, ou -1. */
+static long unite_au_decalage(struct debogueur *dbg, unsigned long decalage)
+{
+    struct table_lignes *t = &dbg->lignes;
+    size_t bas = 0;
+    size_t haut = t->nb_unites;
+    while (bas < haut)
+    {
+        size_t milieu = (bas + haut) / 2;
+        unsigned long debut =
+            (unsigned long)(t->unites[milieu].entete - dbg->elf.debug_line);
+        if (debut == decalage)
+            return (long)milieu;
+        if (debut < decalage)
+            bas = milieu + 1;
+        else
+            haut = milieu;
+    }
+    return -1;
+}
+
+/* Associe chaque unite de compilation a son unite de .debug_line et releve
+ * ses plages d'adresses, d'abord dans .debug_aranges, a defaut dans
+ * DW_AT_low_pc/high_pc. Les unites sans plage restent decodees a la
+ * demande par chercher_ligne. */
+static void indexer_plages(struct debogueur *dbg)
+{
+    struct donnees_elf *elf = &dbg->elf;
+    struct table_lignes *t = &dbg->lignes;
+    if (!elf->debug_info || !elf->debug_abbrev || !t->nb_unites)
+        return;
+
+    /* Unite de .debug_line de chaque unite de compilation, par decalage. */
+    struct lien_unite
+    {
+        unsigned long decalage_info;
+        long unite;
+        struct attributs_unite attributs;
+    } *liens = NULL;
+    size_t nb_liens = 0;
+    const unsigned char *p = elf->debug_info;
+    const unsigned char *fin = p + elf->taille_debug_info;
+    while (p < fin)
+    {
+        struct attributs_unite attributs;
+        unsigned long decalage = (unsigned long)(p - elf->debug_info);
+        if (!lire_unite_info(elf, &p, &attributs))
+            break;
+        if (!attributs.lignes_connues)
+            continue;
+        long unite = unite_au_decalage(dbg, attributs.decalage_lignes);
+        if (unite < 0)
+            continue;
+        struct lien_unite *nouveaux =
+            realloc(liens, (nb_liens + 1) * sizeof(*nouveaux));
+        if (!nouveaux)
+            break;
+        liens = nouveaux;
+        liens[nb_liens].decalage_info = decalage;
+        liens[nb_liens].unite = unite;
+        liens[nb_liens].attributs = attributs;
+        nb_liens++;
+    }
+
+    int echec = 0;
+    p = elf->debug_aranges;
+    fin = p + elf->taille_debug_aranges;
+    while (p && p + 4 <= fin && !echec)
+    {
+        const unsigned char *debut = p;
+        unsigned long longueur = lire_fixe(&p, 4);
+        int format_64 = longueur == 0xFFFFFFFFUL;
+        if (format_64)
+        {
+            if (p + 8 > fin)
+                break;
+            longueur = lire_fixe(&p, 8);
+        }
+        if (longueur > (unsigned long)(fin - p))
+            break;
+        const unsigned char *fin_ensemble = p + longueur;
+        size_t taille_decalage = format_64 ? 8 : 4;
+        if (p + 2 + taille_decalage + 2 > fin_ensemble)
+        {
+            p = fin_ensemble;
+            continue;
+        }
+        p += 2; /* version */
+        unsigned long decalage_info = lire_fixe(&p, taille_decalage);
+        size_t taille_adresse = *p++;
+        size_t taille_segment = *p++;
+        if ((taille_adresse != 4 && taille_adresse != 8) || taille_segment)
+        {
+            p = fin_ensemble;
+            continue;
+        }
+
+        /* Unite de compilation de l'ensemble, par recherche dichotomique :
+         * les liens suivent l'ordre de .debug_info. */
+        size_t bas = 0;
+        size_t haut = nb_liens;
+        while (bas < haut)
+        {
+            size_t milieu = (bas + haut) / 2;
+            if (liens[milieu].decalage_info < decalage_info)
+                bas = milieu + 1;
+            else
+                haut = milieu;
+        }
+        if (bas < nb_liens && liens[bas].decalage_info == decalage_info)
+        {
+            long unite = liens[bas].unite;
+            /* Les couples sont alignes sur leur double taille. */
+            size_t alignement = 2 * taille_adresse;
+            size_t decalage = (size_t)(p - debut);
+            p = debut + (decalage + alignement - 1) / alignement * alignement;
+            while (p + alignement <= fin_ensemble)
+            {
+                unsigned long adresse = lire_fixe(&p, taille_adresse);
+                unsigned long taille = lire_fixe(&p, taille_adresse);
+                if (adresse == 0 && taille == 0)
+                    break;
+                if (adresse && taille
+                    && !ajouter_plage(t, adresse, adresse + taille,
+                                      (size_t)unite))
+                {
+                    echec = 1;
+                    break;
+                }
+            }
+        }
+        p = fin_ensemble;
+    }
+
+    for (size_t i = 0; i < nb_liens && !echec; i++)
+    {
+        struct attributs_unite *a = &liens[i].attributs;
+        if (a->plage_connue && !t->unites[liens[i].unite].plage_connue)
+            echec = !ajouter_plage(t, a->bas, a->haut, (size_t)liens[i].unite);
+    }
+    free(liens);
+    if (echec)
+    {
+        /* Table incomplete : toutes les unites repassent a la demande. */
+        for (size_t i = 0; i < t->nb_unites; i++)
+            t->unites[i].plage_connue = 0;
+        free(t->plages);
+        t->plages = NULL;
+        t->nb_plages = 0;
+        return;
+    }
+    qsort(t->plages, t->nb_plages, sizeof(*t->plages), comparer_plages);
+}
+
+static void indexer_lignes(struct debogueur *dbg)
+{
+    struct table_lignes *t = &dbg->lignes;
+    if (t->indexee)
+        return;
+    t->indexee = 1;
+
+    const unsigned char *p = dbg->elf.debug_line;
+    const unsigned char *fin = p + dbg->elf.taille_debug_line;
+    while (p && p < fin)
+    {
+        struct unite_lignes u;
+        if (!lire_entete_lignes(&dbg->elf, &u, p, fin))
+        {
+            free(u.fichiers);
+            break;
+        }
+        struct unite_lignes *unites =
+            realloc(t->unites, (t->nb_unites + 1) * sizeof(*unites));
+        if (!unites)
+        {
+            free(u.fichiers);
+            break;
+        }
+        t->unites = unites;
+        t->unites[t->nb_unites++] = u;
+        p = u.fin;
+    }
+    indexer_plages(dbg);
+}
+
+static int ajouter_ligne(struct unite_lignes *u, unsigned long adresse,
+                         unsigned long fichier, long ligne, int stmt,
+                         int fin_sequence)
+{
+    if (u->nb_lignes == u->capacite_lignes)
+    {
+        size_t capacite = u->capacite_lignes ? u->capacite_lignes * 2 : 64;
+        struct ligne_source *lignes =
+            realloc(u->lignes, capacite * sizeof(*lignes));
+        if (!lignes)
+            return 0;
+        u->lignes = lignes;
+        u->capacite_lignes = capacite;
+    }
+    struct ligne_source *l = &u->lignes[u->nb_lignes];
+    l->adresse = adresse;
+    l->fichier = (unsigned)fichier;
+    l->ligne = (unsigned)ligne;
+    l->stmt = stmt;
+    l->fin_sequence = fin_sequence;
+    l->ordre = (unsigned)u->nb_lignes++;
+    return 1;
+}
+
+static int comparer_lignes(const void *a, const void *b)
+{
+    const struct ligne_source *la = a;
+    const struct ligne_source *lb = b;
+    if (la->adresse != lb->adresse)
+        return la->adresse < lb->adresse ? -1 : 1;
+    /* A adresse egale, la fin d'une sequence precede la suivante. */
+    if (la->fin_sequence != lb->fin_sequence)
+        return la->fin_sequence ? -1 : 1;
+    return la->ordre < lb->ordre ? -1 : 1;
+}
+
+static uint32_t hacher_ligne(const char *fichier, unsigned ligne)
+{
+    uint32_t h = 2166136261u;
+    while (*fichier)
+        h = (h ^ (unsigned char)*fichier++) * 16777619u;
+    return (h ^ ligne) * 16777619u;
+}
+
+static void inserer_fichier_ligne(struct table_lignes *t, const char *fichier,
+                                  unsigned ligne, unsigned long adresse)
+{
+    if (t->nb_entrees + 1 > t->nb_seaux / 2)
+    {
+        size_t nb_seaux = t->nb_seaux ? t->nb_seaux * 2 : 1024;
+        int *seaux = malloc(nb_seaux * sizeof(*seaux));
+        struct entree_fichier_ligne *entrees =
+            realloc(t->entrees, nb_seaux / 2 * sizeof(*entrees));
+        if (!seaux || !entrees)
+        {
+            free(seaux);
+            if (entrees)
+                t->entrees = entrees;
+            return;
+        }
+        t->entrees = entrees;
+        free(t->seaux);
+        t->seaux = seaux;
+        t->nb_seaux = nb_seaux;
+        for (size_t i = 0; i < nb_seaux; i++)
+            seaux[i] = -1;
+        for (size_t i = 0; i < t->nb_entrees; i++)
+        {
+            size_t s = t->entrees[i].hachage & (nb_seaux - 1);
+            t->entrees[i].suivante = seaux[s];
+            seaux[s] = (int)i;
+        }
+    }
+
+    struct entree_fichier_ligne *e = &t->entrees[t->nb_entrees];
+    e->hachage = hacher_ligne(fichier, ligne);
+    e->fichier = fichier;
+    e->ligne = ligne;
+    e->adresse = adresse;
+    size_t s = e->hachage & (t->nb_seaux - 1);
+    e->suivante = t->seaux[s];
+    t->seaux[s] = (int)t->nb_entrees++;
+}
+
+/* Execute le programme de lignes de l'unite, trie les lignes par adresse
+ * et les ajoute a l'index fichier:ligne. */
+static void decoder_unite(struct table_lignes *t, struct unite_lignes *u)
+{
+    if (u->decodee)
+        return;
+    u->decodee = 1;
+
+    const unsigned char *p = u->programme;
+    const unsigned char *fin = u->fin;
+    unsigned long adresse = 0;
+    unsigned long fichier = 1;
+    long ligne = 1;
+    int stmt = u->stmt_defaut;
+    unsigned long valeur;
+    long decalage;
+
+    while (p < fin)
+    {
+        unsigned char op = *p++;
+        if (op >= u->base_opcodes)
+        {
+            unsigned ajuste = op - u->base_opcodes;
+            adresse += (ajuste / u->plage_lignes) * u->longueur_min_instruction;
+            ligne += u->base_lignes + (int)(ajuste % u->plage_lignes);
+            ajouter_ligne(u, adresse, fichier, ligne, stmt, 0);
+            continue;
+        }
+
+        switch (op)
+        {
+        case 0: {
+            if (!lire_uleb(&p, fin, &valeur) || valeur == 0
+                || valeur > (unsigned long)(fin - p))
+                return;
+            const unsigned char *suite = p + valeur;
+            unsigned char sous_op = *p++;
+            if (sous_op == DW_LNE_end_sequence)
+            {
+                ajouter_ligne(u, adresse, fichier, ligne, stmt, 1);
+                adresse = 0;
+                fichier = 1;
+                ligne = 1;
+                stmt = u->stmt_defaut;
+            }
+            else if (sous_op == DW_LNE_set_address && valeur == 9)
+                adresse = lire_fixe(&p, 8);
+            p = suite;
+            break;
+        }
+        case DW_LNS_copy:
+            ajouter_ligne(u, adresse, fichier, ligne, stmt, 0);
+            break;
+        case DW_LNS_advance_pc:
+            if (!lire_uleb(&p, fin, &valeur))
+                return;
+            adresse += valeur * u->longueur_min_instruction;
+            break;
+        case DW_LNS_advance_line:
+            if (!lire_sleb(&p, fin, &decalage))
+                return;
+            ligne += decalage;
+            break;
+        case DW_LNS_set_file:
+            if (!lire_uleb(&p, fin, &fichier))
+                return;
+            break;
+        case DW_LNS_negate_stmt:
+            stmt = !stmt;
+            break;
+        case DW_LNS_const_add_pc:
+            adresse += ((255 - u->base_opcodes) / u->plage_lignes)
+                * u->longueur_min_instruction;
+            break;
+        case DW_LNS_fixed_advance_pc:
+            if (p + 2 > fin)
+                return;
+            adresse += lire_fixe(&p, 2);
+            break;
+        default:
+            /* Opcodes standard sans effet ici : on saute leurs arguments. */
+            for (unsigned char a = 0; a < u->longueurs_opcodes[op - 1]; a++)
+            {
+                if (!lire_uleb(&p, fin, &valeur))
+                    return;
+            }
+        }
+    }
+
+    if (!u->nb_lignes)
+        return;
+    qsort(u->lignes, u->nb_lignes, sizeof(*u->lignes), comparer_lignes);
+    u->bas = (unsigned long)-1;
+    for (size_t i = 0; i < u->nb_lignes; i++)
+    {
+        struct ligne_source *l = &u->lignes[i];
+        if (l->adresse == 0)
+            continue;
+        if (l->adresse < u->bas)
+            u->bas = l->adresse;
+        if (l->adresse > u->haut)
+            u->haut = l->adresse;
+        if (l->stmt && !l->fin_sequence && l->fichier < u->nb_fichiers
+            && u->fichiers[l->fichier])
+            inserer_fichier_ligne(t, u->fichiers[l->fichier], l->ligne,
+                                  l->adresse);
+    }
+}
+
+/* Derniere ligne de l'unite d'adresse <= addr, ou NULL si addr tombe hors
+ * de ses sequences. */
+static struct ligne_source *ligne_dans_unite(struct unite_lignes *u,
+                                             unsigned long addr)
+{
+    if (!u->nb_lignes || addr < u->bas || addr >= u->haut)
+        return NULL;
+    size_t bas = 0;
+    size_t haut = u->nb_lignes;
+    while (bas < haut)
+    {
+        size_t milieu = (bas + haut) / 2;
+        if (u->lignes[milieu].adresse <= addr)
+            bas = milieu + 1;
+        else
+            haut = milieu;
+    }
+    if (bas == 0 || u->lignes[bas - 1].fin_sequence)
+        return NULL;
+    return &u->lignes[bas - 1];
+}
+
+/* Derniere ligne d'adresse <= addr, ou NULL si addr tombe hors de toute
+ * sequence. Seule l'unite dont une plage couvre addr est decodee ; les
+ * unites sans plage connue le sont une fois, au premier echec, et les
+ * echecs suivants ne coutent plus qu'un parcours de leurs bornes. */
+static struct ligne_source *chercher_ligne(struct debogueur *dbg,
+                                           unsigned long addr,
+                                           struct unite_lignes **unite)
+{
+    struct table_lignes *t = &dbg->lignes;
+    indexer_lignes(dbg);
+
+    struct ligne_source *l;
+    size_t bas = 0;
+    size_t haut = t->nb_plages;
+    while (bas < haut)
+    {
+        size_t milieu = (bas + haut) / 2;
+        if (t->plages[milieu].bas <= addr)
+            bas = milieu + 1;
+        else
+            haut = milieu;
+    }
+    if (bas > 0 && addr < t->plages[bas - 1].haut)
+    {
+        struct unite_lignes *u = &t->unites[t->plages[bas - 1].unite];
+        decoder_unite(t, u);
+        l = ligne_dans_unite(u, addr);
+        if (l)
+        {
+            if (unite)
+                *unite = u;
+            return l;
+        }
+    }
+
+    for (size_t i = 0; i < t->nb_unites; i++)
+    {
+        struct unite_lignes *u = &t->unites[i];
+        if (u->plage_connue)
+            continue;
+        decoder_unite(t, u);
+        l = ligne_dans_unite(u, addr);
+        if (l)
+        {
+            if (unite)
+                *unite = u;
+            return l;
+        }
+    }
+    return NULL;
+}
+
+static const char *nom_fichier_ligne(struct unite_lignes *u,
+                                     struct ligne_source *l)
+{
+    if (l->fichier < u->nb_fichiers && u->fichiers[l->fichier])
+        return u->fichiers[l->fichier];
+    return "??";
+}
+
+static int unite_contient_fichier(struct unite_lignes *u, const char *nom)
+{
+    for (size_t i = 0; i < u->nb_fichiers; i++)
+    {
+        if (u->fichiers[i] && strcmp(u->fichiers[i], nom) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/* Plus petite adresse de la premiere ligne >= ligne ayant du code dans
+ * le fichier. Seules les unites citant ce fichier sont decodees. */
+static unsigned long adresse_fichier_ligne(struct debogueur *dbg,
+                                           const char *fichier,
+                                           unsigned ligne)
+{
+    struct table_lignes *t = &dbg->lignes;
+    const char *nom = nom_de_base(fichier);
+    indexer_lignes(dbg);
+    for (size_t i = 0; i < t->nb_unites; i++)
+    {
+        if (unite_contient_fichier(&t->unites[i], nom))
+            decoder_unite(t, &t->unites[i]);
+    }
+    if (!t->nb_seaux)
+        return (unsigned long)-1;
+
+    for (unsigned l = ligne; l < ligne + MAX_DECALAGE_LIGNE; l++)
+    {
+        uint32_t h = hacher_ligne(nom, l);
+        unsigned long meilleure = (unsigned long)-1;
+        for (int e = t->seaux[h & (t->nb_seaux - 1)]; e != -1;
+             e = t->entrees[e].suivante)
+        {
+            struct entree_fichier_ligne *entree = &t->entrees[e];
+            if (entree->hachage == h && entree->ligne == l
+                && strcmp(entree->fichier, nom) == 0
+                && entree->adresse < meilleure)
+                meilleure = entree->adresse;
+        }
+        if (meilleure != (unsigned long)-1)
+            return meilleure;
+    }
+    return (unsigned long)-1;
+}
+
+static void liberer_lignes(struct table_lignes *t)
+{
+    for (size_t i = 0; i < t->nb_unites; i++)
+    {
+        free(t->unites[i].fichiers);
+        free(t->unites[i].lignes);
+    }
+    free(t->unites);
+    free(t->entrees);
+    free(t->seaux);
+    free(t->plages);
+    memset(t, 0, sizeof(*t));
+}
+
+static void afficher_ligne_source(struct debogueur *dbg, unsigned long addr)
+{
+    struct unite_lignes *u;
+    struct ligne_source *l = chercher_ligne(dbg, addr, &u);
+    if (l)
+        printf(" (%s:%u)", nom_fichier_ligne(u, l), l->ligne);
+}
+
+/* Pose un int3 temporaire sur chaque adresse et continue jusqu'au premier
+ * arret. Retourne 1 si l'une d'elles est atteinte, 0 pour un autre arret
+ * et -1 si le programme s'est termine. */
+static int continuer_jusqu_a(struct debogueur *dbg, unsigned long *adresses,
+                             size_t nb)
+{
+    long *originales = malloc(nb * sizeof(*originales));
+    int *posees = calloc(nb, sizeof(*posees));
+    if (!originales || !posees)
+    {
+        free(originales);
+        free(posees);
+        return 0;
+    }
+
+    for (size_t i = 0; i < nb; i++)
+    {
+        int deja = chevauche_point_arret(dbg, adresses[i], 1)
+            || chevauche_point_trace(dbg, adresses[i], 1);
+        for (size_t j = 0; j < i && !deja; j++)
+            deja = adresses[j] == adresses[i];
+        if (deja)
+            continue;
+        errno = 0;
+        originales[i] = ptrace(PTRACE_PEEKDATA, dbg->pid_fils, adresses[i],
+                               NULL);
+        if (errno != 0)
+            continue;
+        long int3 = (originales[i] & ~0xFF) | 0xCC;
+        if (ptrace(PTRACE_POKEDATA, dbg->pid_fils, adresses[i], int3) != -1)
+            posees[i] = 1;
+    }
+
+    int resultat = 0;
+    int statut = 0;
+    if (ptrace(PTRACE_CONT, dbg->pid_fils, NULL, NULL) == -1)
+        echouer_systeme(dbg, "ptrace continue");
+    else
+    {
+        waitpid(dbg->pid_fils, &statut, 0);
+        reprendre_enregistrement(dbg, statut);
+    }
+
+    if (WIFEXITED(statut))
+    {
+        printf("Programme terminé avec le code %d\n", WEXITSTATUS(statut));
+        free(originales);
+        free(posees);
+        return -1;
+    }
+
+    /* Ordre inverse : deux adresses peuvent partager le meme mot. */
+    for (size_t i = nb; i-- > 0;)
+    {
+        if (posees[i])
+            ptrace(PTRACE_POKEDATA, dbg->pid_fils, adresses[i],
+                   originales[i]);
+    }
+
+    if (WIFSTOPPED(statut) && WSTOPSIG(statut) == SIGTRAP)
+    {
+        struct user_regs_struct regs;
+        ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &regs);
+        for (size_t i = 0; i < nb; i++)
+        {
+            if (posees[i] && adresses[i] == regs.rip - 1)
+            {
+                regs.rip--;
+                ptrace(PTRACE_SETREGS, dbg->pid_fils, NULL, &regs);
+                resultat = 1;
+                break;
+            }
+        }
+        if (!resultat)
+            gerer_point_arret(dbg);
+    }
+    else if (WIFSTOPPED(statut))
+        gerer_signaux(dbg, WSTOPSIG(statut));
+
+    free(originales);
+    free(posees);
+    return resultat;
+}
+
+/* Adresse apres le prologue : la deuxieme ligne de la fonction, comme le
+ * fait GDB a partir de la table des lignes. */
+static unsigned long sauter_prologue(struct debogueur *dbg,
+                                     unsigned long fonction)
+{
+    struct unite_lignes *u;
+    struct ligne_source *l = chercher_ligne(dbg, fonction, &u);
+    if (!l)
+        return fonction;
+    for (struct ligne_source *s = l + 1; s < u->lignes + u->nb_lignes; s++)
+    {
+        if (s->fin_sequence)
+            break;
+        if (s->stmt && s->adresse > fonction)
+            return s->adresse;
+    }
+    return fonction;
+}
+
+static int ajouter_adresse(unsigned long **adresses, size_t *nb,
+                           size_t *capacite, unsigned long adresse)
+{
+    if (*nb == *capacite)
+    {
+        unsigned long *plus =
+            realloc(*adresses, 2 * *capacite * sizeof(**adresses));
+        if (!plus)
+            return 0;
+        *adresses = plus;
+        *capacite *= 2;
+    }
+    (*adresses)[(*nb)++] = adresse;
+    return 1;
+}
+
+/* Appels directs de [debut, fin) vers du code avec des lignes : l'arret
+ * se fait apres le prologue de la fonction appelee. */
+static void ajouter_appels(struct debogueur *dbg, unsigned long debut,
+                           unsigned long fin, unsigned long **adresses,
+                           size_t *nb, size_t *capacite)
+{
+    unsigned char code[TAILLE_LECTURE_CODE * 8];
+    size_t taille_code = fin - debut;
+    if (taille_code > sizeof(code))
+        taille_code = sizeof(code);
+    if (!taille_code || !lire_memoire(dbg, debut, code, taille_code))
+        return;
+
+    size_t pos = 0;
+    struct instruction ins;
+    while (pos < taille_code
+           && decoder_instruction(code + pos, taille_code - pos, &ins))
+    {
+        if (ins.carte == 1 && ins.opcode == 0xE8)
+        {
+            int32_t rel;
+            memcpy(&rel, code + pos + ins.pos_immediat, 4);
+            unsigned long cible = debut + pos + ins.longueur + rel;
+            if (chercher_ligne(dbg, cible, NULL)
+                && !ajouter_adresse(adresses, nb, capacite,
+                                    sauter_prologue(dbg, cible)))
+                return;
+        }
+        pos += ins.longueur;
+    }
+}
+
+/* Pointeur code selon DW_EH_PE : seuls les codages absolus et relatifs a
+ * leur propre position sont pris en charge. */
+static int lire_pointeur_eh(struct donnees_elf *elf, const unsigned char **p,
+                            const unsigned char *fin, int codage,
+                            unsigned long *valeur)
+{
+    unsigned long base = 0;
+    unsigned long brut;
+    long signe;
+    size_t taille;
+    if ((codage & 0x70) == DW_EH_PE_pcrel)
+        base = elf->adresse_eh_frame + (unsigned long)(*p - elf->eh_frame);
+    else if (codage & 0x70)
+        return 0;
+    switch (codage & 0x0F)
+    {
+    case DW_EH_PE_uleb128:
+        if (!lire_uleb(p, fin, &brut))
+            return 0;
+        *valeur = base + brut;
+        return 1;
+    case DW_EH_PE_sleb128:
+        if (!lire_sleb(p, fin, &signe))
+            return 0;
+        *valeur = base + (unsigned long)signe;
+        return 1;
+    case DW_EH_PE_absptr:
+    case DW_EH_PE_udata8:
+    case DW_EH_PE_sdata8:
+        taille = 8;
+        break;
+    case DW_EH_PE_udata2:
+    case DW_EH_PE_sdata2:
+        taille = 2;
+        break;
+    case DW_EH_PE_udata4:
+    case DW_EH_PE_sdata4:
+        taille = 4;
+        break;
+    default:
+        return 0;
+    }
+    if (taille > (size_t)(fin - *p))
+        return 0;
+    brut = lire_fixe(p, taille);
+    if ((codage & 0x08) && taille < 8 && (brut >> (8 * taille - 1)) & 1)
+        brut |= ~0UL << (8 * taille);
+    *valeur = base + brut;
+    return 1;
+}
+
+/* Regle de cadre en un point du code : CFA = registre + decalage, et
+ * adresse de retour rangee en CFA + decalage_retour. */
+struct regle_cadre
+{
+    unsigned long registre_cfa; /* numero DWARF */
+    long decalage_cfa;
+    long decalage_retour;
+    int cfa_connu;
+    int retour_connu;
+};
+
+struct cie_eh
+{
+    unsigned long alignement_code;
+    long alignement_donnees;
+    unsigned long registre_retour;
+    int codage_fde;
+    int augmentation_z;
+    const unsigned char *instructions;
+    const unsigned char *fin;
+};
+
+static int lire_cie(struct donnees_elf *elf, const unsigned char *p,
+                    const unsigned char *fin, struct cie_eh *cie)
+{
+    memset(cie, 0, sizeof(*cie));
+    cie->codage_fde = DW_EH_PE_absptr;
+    cie->fin = fin;
+    if (p >= fin)
+        return 0;
+    int version = *p++;
+    const char *augmentation = (const char *)p;
+    p += strnlen(augmentation, (size_t)(fin - p)) + 1;
+    if (p > fin || !lire_uleb(&p, fin, &cie->alignement_code)
+        || !lire_sleb(&p, fin, &cie->alignement_donnees))
+        return 0;
+    if (version == 1)
+    {
+        if (p >= fin)
+            return 0;
+        cie->registre_retour = *p++;
+    }
+    else if (!lire_uleb(&p, fin, &cie->registre_retour))
+        return 0;
+
+    if (augmentation[0] != 'z')
+    {
+        cie->instructions = p;
+        return augmentation[0] == '\0';
+    }
+    cie->augmentation_z = 1;
+    unsigned long longueur;
+    if (!lire_uleb(&p, fin, &longueur) || longueur > (unsigned long)(fin - p))
+        return 0;
+    cie->instructions = p + longueur;
+    for (const char *c = augmentation + 1; *c; c++)
+    {
+        unsigned long ignore;
+        if (*c == 'R' && p < fin)
+            cie->codage_fde = *p++;
+        else if (*c == 'L' && p < fin)
+            p++;
+        else if (*c == 'P' && p < fin)
+        {
+            int codage = *p++;
+            if (!lire_pointeur_eh(elf, &p, fin, codage, &ignore))
+                return 0;
+        }
+        else if (*c != 'S')
+            return 0;
+    }
+    return 1;
+}
+
+/* Execute les instructions CFI jusqu'a l'adresse cible (exclue pour les
+ * avances). initiale est la regle issue de la CIE, pour DW_CFA_restore. */
+static int executer_cfi(struct donnees_elf *elf, const struct cie_eh *cie,
+                        const unsigned char *p, const unsigned char *fin,
+                        unsigned long position, unsigned long cible,
+                        const struct regle_cadre *initiale,
+                        struct regle_cadre *regle)
+{
+    struct regle_cadre pile[MAX_ETATS_CFI];
+    int profondeur = 0;
+    while (p < fin)
+    {
+        unsigned char op = *p++;
+        unsigned long registre = op & 0x3F;
+        unsigned long delta = 0;
+        unsigned long u1;
+        unsigned long u2;
+        long s2;
+        switch (op & 0xC0)
+        {
+        case DW_CFA_advance_loc:
+            delta = op & 0x3F;
+            break;
+        case DW_CFA_offset:
+            if (!lire_uleb(&p, fin, &u2))
+                return 0;
+            if (registre == cie->registre_retour)
+            {
+                regle->decalage_retour = (long)u2 * cie->alignement_donnees;
+                regle->retour_connu = 1;
+            }
+            continue;
+        case DW_CFA_restore:
+            if (registre == cie->registre_retour)
+            {
+                regle->decalage_retour = initiale->decalage_retour;
+                regle->retour_connu = initiale->retour_connu;
+            }
+            continue;
+        default:
+            switch (op)
+            {
+            case DW_CFA_nop:
+            case DW_CFA_GNU_args_size:
+                if (op == DW_CFA_GNU_args_size && !lire_uleb(&p, fin, &u1))
+                    return 0;
+                continue;
+            case DW_CFA_set_loc:
+                if (!lire_pointeur_eh(elf, &p, fin, cie->codage_fde, &u1))
+                    return 0;
+                if (u1 > cible)
+                    return 1;
+                position = u1;
+                continue;
+            case DW_CFA_advance_loc1:
+            case DW_CFA_advance_loc2:
+            case DW_CFA_advance_loc4:
+            {
+                size_t taille = op == DW_CFA_advance_loc1 ? 1
+                    : op == DW_CFA_advance_loc2 ? 2 : 4;
+                if (taille > (size_t)(fin - p))
+                    return 0;
+                delta = lire_fixe(&p, taille);
+                break;
+            }
+            case DW_CFA_offset_extended:
+            case DW_CFA_val_offset:
+            case DW_CFA_GNU_negative_offset_extended:
+                if (!lire_uleb(&p, fin, &u1) || !lire_uleb(&p, fin, &u2))
+                    return 0;
+                if (u1 == cie->registre_retour)
+                {
+                    long decalage = (long)u2 * cie->alignement_donnees;
+                    regle->decalage_retour =
+                        op == DW_CFA_GNU_negative_offset_extended ? -decalage
+                                                                  : decalage;
+                    /* val_offset donne la valeur, pas son emplacement. */
+                    regle->retour_connu = op != DW_CFA_val_offset;
+                }
+                continue;
+            case DW_CFA_offset_extended_sf:
+            case DW_CFA_val_offset_sf:
+                if (!lire_uleb(&p, fin, &u1) || !lire_sleb(&p, fin, &s2))
+                    return 0;
+                if (u1 == cie->registre_retour)
+                {
+                    regle->decalage_retour = s2 * cie->alignement_donnees;
+                    regle->retour_connu = op == DW_CFA_offset_extended_sf;
+                }
+                continue;
+            case DW_CFA_restore_extended:
+            case DW_CFA_undefined:
+            case DW_CFA_same_value:
+                if (!lire_uleb(&p, fin, &u1))
+                    return 0;
+                if (u1 == cie->registre_retour)
+                {
+                    regle->decalage_retour = initiale->decalage_retour;
+                    regle->retour_connu = op == DW_CFA_restore_extended
+                        && initiale->retour_connu;
+                }
+                continue;
+            case DW_CFA_register:
+                if (!lire_uleb(&p, fin, &u1) || !lire_uleb(&p, fin, &u2))
+                    return 0;
+                if (u1 == cie->registre_retour)
+                    regle->retour_connu = 0;
+                continue;
+            case DW_CFA_remember_state:
+                if (profondeur == MAX_ETATS_CFI)
+                    return 0;
+                pile[profondeur++] = *regle;
+                continue;
+            case DW_CFA_restore_state:
+                if (profondeur == 0)
+                    return 0;
+                *regle = pile[--profondeur];
+                continue;
+            case DW_CFA_def_cfa:
+                if (!lire_uleb(&p, fin, &u1) || !lire_uleb(&p, fin, &u2))
+                    return 0;
+                regle->registre_cfa = u1;
+                regle->decalage_cfa = (long)u2;
+                regle->cfa_connu = 1;
+                continue;
+            case DW_CFA_def_cfa_sf:
+                if (!lire_uleb(&p, fin, &u1) || !lire_sleb(&p, fin, &s2))
+                    return 0;
+                regle->registre_cfa = u1;
+                regle->decalage_cfa = s2 * cie->alignement_donnees;
+                regle->cfa_connu = 1;
+                continue;
+            case DW_CFA_def_cfa_register:
+                if (!lire_uleb(&p, fin, &u1))
+                    return 0;
+                regle->registre_cfa = u1;
+                continue;
+            case DW_CFA_def_cfa_offset:
+                if (!lire_uleb(&p, fin, &u1))
+                    return 0;
+                regle->decalage_cfa = (long)u1;
+                continue;
+            case DW_CFA_def_cfa_offset_sf:
+                if (!lire_sleb(&p, fin, &s2))
+                    return 0;
+                regle->decalage_cfa = s2 * cie->alignement_donnees;
+                continue;
+            case DW_CFA_def_cfa_expression:
+                if (!lire_uleb(&p, fin, &u1)
+                    || u1 > (unsigned long)(fin - p))
+                    return 0;
+                p += u1;
+                regle->cfa_connu = 0;
+                continue;
+            case DW_CFA_expression:
+            case DW_CFA_val_expression:
+                if (!lire_uleb(&p, fin, &u1) || !lire_uleb(&p, fin, &u2)
+                    || u2 > (unsigned long)(fin - p))
+                    return 0;
+                p += u2;
+                if (u1 == cie->registre_retour)
+                    regle->retour_connu = 0;
+                continue;
+            default:
+                return 0;
+            }
+        }
+        position += delta * cie->alignement_code;
+        if (position > cible)
+            return 1;
+    }
+    return 1;
+}
+
+/* Cherche dans .eh_frame la FDE qui couvre addr et calcule la regle de
+ * cadre en ce point. */
+static int regle_cadre(struct donnees_elf *elf, unsigned long addr,
+                       struct regle_cadre *regle)
+{
+    const unsigned char *p = elf->eh_frame;
+    const unsigned char *fin_section = p + elf->taille_eh_frame;
+    while (p && p + 4 <= fin_section)
+    {
+        unsigned long longueur = lire_fixe(&p, 4);
+        if (longueur == 0)
+            break;
+        if (longueur == 0xFFFFFFFFUL
+            || longueur > (unsigned long)(fin_section - p))
+            return 0;
+        const unsigned char *fin = p + longueur;
+        const unsigned char *champ_cie = p;
+        if (p + 4 > fin)
+            return 0;
+        unsigned long pointeur_cie = lire_fixe(&p, 4);
+        if (pointeur_cie == 0
+            || pointeur_cie > (unsigned long)(champ_cie - elf->eh_frame))
+        {
+            p = fin;
+            continue;
+        }
+
+        /* FDE : la CIE est a pointeur_cie octets en arriere. */
+        const unsigned char *q = champ_cie - pointeur_cie;
+        if (q + 8 > fin_section)
+            return 0;
+        unsigned long longueur_cie = lire_fixe(&q, 4);
+        if (longueur_cie > (unsigned long)(fin_section - q))
+            return 0;
+        const unsigned char *fin_cie = q + longueur_cie;
+        q += 4; /* identifiant de CIE */
+        struct cie_eh cie;
+        unsigned long debut_fde;
+        unsigned long taille_fde;
+        if (!lire_cie(elf, q, fin_cie, &cie)
+            || !lire_pointeur_eh(elf, &p, fin, cie.codage_fde, &debut_fde)
+            || !lire_pointeur_eh(elf, &p, fin, cie.codage_fde & 0x0F,
+                                 &taille_fde))
+        {
+            p = fin;
+            continue;
+        }
+        if (addr < debut_fde || addr - debut_fde >= taille_fde)
+        {
+            p = fin;
+            continue;
+        }
+        if (cie.augmentation_z)
+        {
+            unsigned long longueur_augmentation;
+            if (!lire_uleb(&p, fin, &longueur_augmentation)
+                || longueur_augmentation > (unsigned long)(fin - p))
+                return 0;
+            p += longueur_augmentation;
+        }
+
+        struct regle_cadre initiale;
+        memset(&initiale, 0, sizeof(initiale));
+        if (!executer_cfi(elf, &cie, cie.instructions, cie.fin, debut_fde,
+                          (unsigned long)-1, &initiale, &initiale))
+            return 0;
+        *regle = initiale;
+        return executer_cfi(elf, &cie, p, fin, debut_fde, addr, &initiale,
+                            regle)
+            && regle->cfa_connu && regle->retour_connu;
+    }
+    return 0;
+}
+
+/* Valeur d'un registre selon la numerotation DWARF de x86-64. */
+static int registre_dwarf(const struct user_regs_struct *regs,
+                          unsigned long numero, unsigned long *valeur)
+{
+    const unsigned long long valeurs[] = {
+        regs->rax, regs->rdx, regs->rcx, regs->rbx, regs->rsi, regs->rdi,
+        regs->rbp, regs->rsp, regs->r8,  regs->r9,  regs->r10, regs->r11,
+        regs->r12, regs->r13, regs->r14, regs->r15};
+    if (numero >= sizeof(valeurs) / sizeof(valeurs[0]))
+        return 0;
+    *valeur = valeurs[numero];
+    return 1;
+}
+
+/* Adresse de retour de la fonction courante. L'emplacement vient de la
+ * regle de cadre de .eh_frame ; sans elle, seule l'entree de la fonction
+ * est sure. L'emplacement doit tomber dans la pile, entre rsp et le haut
+ * de sa region, et l'adresse lue doit etre projetee. */
+static int lire_adresse_retour(struct debogueur *dbg,
+                               const struct user_regs_struct *regs,
+                               unsigned long debut_fonction,
+                               unsigned long *retour)
+{
+    unsigned long emplacement;
+    struct regle_cadre regle;
+    if (regle_cadre(&dbg->elf, regs->rip, &regle))
+    {
+        unsigned long base;
+        if (!registre_dwarf(regs, regle.registre_cfa, &base))
+            return 0;
+        emplacement = base + (unsigned long)regle.decalage_cfa
+            + (unsigned long)regle.decalage_retour;
+    }
+    else if (regs->rip == debut_fonction)
+        emplacement = regs->rsp;
+    else
+        return 0;
+
+    unsigned long debut;
+    unsigned long fin;
+    if (!region_contenant(dbg, regs->rsp, &debut, &fin)
+        || emplacement < regs->rsp || emplacement > fin - sizeof(*retour)
+        || !lire_memoire(dbg, emplacement, retour, sizeof(*retour)))
+        return 0;
+    return region_contenant(dbg, *retour, &debut, &fin);
+}
+
+/* step : avance jusqu'au debut d'une autre ligne source en posant des
+ * points d'arret temporaires sur les lignes de la fonction courante, sur
+ * les fonctions appelees directement depuis la ligne et sur l'adresse de
+ * retour. Une ligne peut occuper plusieurs plages (boucle for) : aucune
+ * d'elles n'arrete le pas, et les appels de chacune sont suivis. */
+static void pas_source(struct debogueur *dbg)
+{
+    for (int essai = 0; essai < MAX_ESSAIS_PAS_SOURCE; essai++)
+    {
+        struct user_regs_struct regs;
+        if (ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &regs) == -1)
+        {
+            echouer_systeme(dbg, "step getregs");
+            return;
+        }
+
+        struct unite_lignes *u;
+        struct ligne_source *l = chercher_ligne(dbg, regs.rip, &u);
+        Elf64_Sym *fonction = chercher_symbole(&dbg->elf, regs.rip);
+        if (!l || !fonction)
+        {
+            echouer(dbg, "Pas d'information de ligne pour 0x%llx\n", regs.rip);
+            return;
+        }
+        if (essai > 0 && l->adresse == regs.rip && l->stmt)
+            break;
+
+        unsigned long debut_fonction = fonction->st_value;
+        unsigned long fin_fonction = debut_fonction + fonction->st_size;
+        size_t nb = 0;
+        size_t capacite = 16;
+        unsigned long *adresses = malloc(capacite * sizeof(*adresses));
+        if (!adresses)
+            return;
+        for (size_t i = 0; i < u->nb_lignes; i++)
+        {
+            struct ligne_source *s = &u->lignes[i];
+            if (s->fin_sequence || s->adresse < debut_fonction
+                || s->adresse >= fin_fonction)
+                continue;
+            unsigned long fin = fin_fonction;
+            for (size_t j = i + 1; j < u->nb_lignes; j++)
+            {
+                if (u->lignes[j].adresse > s->adresse)
+                {
+                    if (u->lignes[j].adresse < fin)
+                        fin = u->lignes[j].adresse;
+                    break;
+                }
+            }
+            if (s == l || (s->fichier == l->fichier && s->ligne == l->ligne))
+                ajouter_appels(dbg, s == l ? regs.rip : s->adresse, fin,
+                               &adresses, &nb, &capacite);
+            else if (s->stmt && !(s->adresse <= regs.rip && regs.rip < fin))
+                ajouter_adresse(&adresses, &nb, &capacite, s->adresse);
+        }
+
+        unsigned long retour;
+        if (!lire_adresse_retour(dbg, &regs, debut_fonction, &retour))
+        {
+            echouer(dbg,
+                    "Cadre de pile introuvable à 0x%llx : step impossible\n",
+                    regs.rip);
+            free(adresses);
+            return;
+        }
+        if (!ajouter_adresse(&adresses, &nb, &capacite, retour))
+        {
+            free(adresses);
+            return;
+        }
+
+        int resultat = continuer_jusqu_a(dbg, adresses, nb);
+        free(adresses);
+        if (resultat != 1)
+            return;
+    }
+
+    struct user_regs_struct regs;
+    if (ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &regs) != -1)
+    {
+        printf("Programme arrêté à 0x%llx", regs.rip);
+        afficher_ligne_source(dbg, regs.rip);
+        printf("\n");
+    }
+}
+
+static void afficher_back_trace(struct debogueur *dbg)
+{
+    struct user_regs_struct regs;
+    if (ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &regs) == -1)
+    {
+        echouer_systeme(dbg, "btrace getregs");
+        return;
+    }
+
+    unsigned long rbp = regs.rbp;
+    unsigned long rip = regs.rip;
+    int niveau = 0;
+
+    printf("Back Trace:\n");
+
+    printf("#%d  0x%lx", niveau, rip);
+    for (size_t i = 0; i < dbg->elf.nb_symboles; i++)
+    {
+        if (ELF64_ST_TYPE(dbg->elf.symboles[i].st_info) == STT_FUNC)
+        {
+            unsigned long debut = dbg->elf.symboles[i].st_value;
+            unsigned long fin = debut + dbg->elf.symboles[i].st_size;
+            if (rip >= debut && rip < fin)
+            {
+                printf(" dans %s", nom_symbole(dbg, &dbg->elf.symboles[i]));
+                break;
+            }
+        }
+    }
+    afficher_ligne_source(dbg, rip);
+    printf("\n");
+
+    while (rbp)
+    {
+        errno = 0;
+        unsigned long adr_retour = ptrace(PTRACE_PEEKDATA, dbg->pid_fils, rbp + 8, NULL);
+        if (errno != 0)
+            break;
+
+        errno = 0;
+        unsigned long rbp_suivant = ptrace(PTRACE_PEEKDATA, dbg->pid_fils, rbp, NULL);
+        if (errno != 0)
+            break;
+
+        niveau++;
+        printf("#%d  0x%lx", niveau, adr_retour);
+
+        for (size_t i = 0; i < dbg->elf.nb_symboles; i++)
+        {
+            if (ELF64_ST_TYPE(dbg->elf.symboles[i].st_info) == STT_FUNC)
+            {
+                unsigned long debut = dbg->elf.symboles[i].st_value;
+                unsigned long fin = debut + dbg->elf.symboles[i].st_size;
+                if (adr_retour >= debut && adr_retour < fin)
+                {
+                    printf(" dans %s", nom_symbole(dbg, &dbg->elf.symboles[i]));
+                    break;
+                }
+            }
+        }
+        /* L'adresse de retour suit l'appel : la ligne est celle d'avant. */
+        afficher_ligne_source(dbg, adr_retour - 1);
+        printf("\n");
+
+        if (rbp_suivant <= rbp)
+            break;
+        rbp = rbp_suivant;
+    }
+}
+
+/* Execute un appel systeme dans le fils en posant temporairement une
+ * instruction syscall a son rip courant. */
+static long executer_appel_systeme(struct debogueur *dbg, long numero,
+                                   long a1, long a2, long a3, long a4,
+                                   long a5, long a6)
+{
+    struct user_regs_struct sauvegarde;
+    if (ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &sauvegarde) == -1)
+    {
+        echouer_systeme(dbg, "syscall getregs");
+        return -1;
+    }
+
+    errno = 0;
+    long code = ptrace(PTRACE_PEEKTEXT, dbg->pid_fils, sauvegarde.rip, NULL);
+    if (errno != 0)
+    {
+        echouer_systeme(dbg, "syscall peek");
+        return -1;
+    }
+
+    long syscall_insn = (code & ~0xFFFFL) | 0x050F;
+    struct user_regs_struct regs = sauvegarde;
+    regs.rax = numero;
+    regs.orig_rax = -1;
+    regs.rdi = a1;
+    regs.rsi = a2;
+    regs.rdx = a3;
+    regs.r10 = a4;
+    regs.r8 = a5;
+    regs.r9 = a6;
+
+    long resultat = -1;
+    if (ptrace(PTRACE_POKETEXT, dbg->pid_fils, sauvegarde.rip, syscall_insn)
+            != -1
+        && ptrace(PTRACE_SETREGS, dbg->pid_fils, NULL, &regs) != -1
+        && ptrace(PTRACE_SINGLESTEP, dbg->pid_fils, NULL, NULL) != -1)
+    {
+        int statut;
+        waitpid(dbg->pid_fils, &statut, 0);
+        if (WIFSTOPPED(statut)
+            && ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &regs) != -1)
+            resultat = regs.rax;
+    }
+    else
+        echouer_systeme(dbg, "syscall injection");
+
+    ptrace(PTRACE_POKETEXT, dbg->pid_fils, sauvegarde.rip, code);
+    ptrace(PTRACE_SETREGS, dbg->pid_fils, NULL, &sauvegarde);
+    return resultat;
+}
+
+struct tampon_code
+{
+    unsigned char octets[TAILLE_MAX_TRAMPOLINE];
+    size_t taille;
+    unsigned long adresse; /* adresse du premier octet dans le fils */
+};
+
+static void emettre(struct tampon_code *tc, const unsigned char *octets,
+                    size_t n)
+{
+    memcpy(tc->octets + tc->taille, octets, n);
+    tc->taille += n;
+}
+
+static void emettre_32(struct tampon_code *tc, int32_t valeur)
+{
+    memcpy(tc->octets + tc->taille, &valeur, 4);
+    tc->taille += 4;
+}
+
+/* Deplacement rel32 vers cible, l'instruction se terminant
+ * fin_instruction octets apres la position courante. */
+static void emettre_rel32(struct tampon_code *tc, unsigned long cible,
+                          size_t fin_instruction)
+{
+    unsigned long suivante = tc->adresse + tc->taille + fin_instruction;
+    emettre_32(tc, (int32_t)(cible - suivante));
+}
+
+static int distance_rel32(unsigned long a, unsigned long b)
+{
+    long d = (long)(a - b);
+    return d > -0x7FFF0000L && d < 0x7FFF0000L;
+}
+
+static int allouer_zone_trace(struct debogueur *dbg, unsigned long pres_de)
+{
+    if (dbg->zone_trace)
+        return 1;
+
+    unsigned long indice = (pres_de & ~(TAILLE_PAGE - 1)) + 0x10000000UL;
+    long zone = executer_appel_systeme(
+        dbg, 9 /* mmap */, (long)indice, TAILLE_ZONE_TRACE,
+        0x7 /* PROT_READ | PROT_WRITE | PROT_EXEC */,
+        0x22 /* MAP_PRIVATE | MAP_ANONYMOUS */, -1, 0);
+    if (zone < 0 && zone > -4096)
+    {
+        echouer(dbg, "mmap dans le programme échoué: %s\n",
+                strerror((int)-zone));
+        return 0;
+    }
+    if (zone == -1)
+        return 0;
+
+    dbg->zone_trace = (unsigned long)zone;
+    return 1;
+}
+
+/* Copie les instructions deplacees dans le trampoline en corrigeant les
+ * deplacements relatifs a rip. */
+static int deplacer_instructions(struct tampon_code *tc,
+                                 const unsigned char *code,
+                                 unsigned long origine, size_t taille)
+{
+    size_t pos = 0;
+    while (pos < taille)
+    {
+        struct instruction ins;
+        if (!decoder_instruction(code + pos, TAILLE_LECTURE_CODE - pos, &ins))
+        {
+            printf("Instruction non reconnue à 0x%lx\n", origine + pos);
+            return 0;
+        }
+        if (ins.saut_relatif == 1)
+        {
+            printf("Saut court à 0x%lx impossible à déplacer\n",
+                   origine + pos);
+            return 0;
+        }
+
+        size_t debut = tc->taille;
+        emettre(tc, code + pos, ins.longueur);
+        size_t champ = 0;
+        if (ins.rip_relatif)
+            champ = ins.pos_deplacement;
+        else if (ins.saut_relatif == 4)
+            champ = ins.pos_immediat;
+        if (champ)
+        {
+            int32_t ancien;
+            memcpy(&ancien, code + pos + champ, 4);
+            unsigned long cible = origine + pos + ins.longueur + (long)ancien;
+            unsigned long suivante = tc->adresse + debut + ins.longueur;
+            if (!distance_rel32(cible, suivante))
+                return 0;
+            int32_t nouveau = (int32_t)(cible - suivante);
+            memcpy(tc->octets + debut + champ, &nouveau, 4);
+        }
+        pos += ins.longueur;
+    }
+    return 1;
+}
+
+static void generer_comptage(struct tampon_code *tc, unsigned long compteur)
+{
+    static const unsigned char lock_inc[] = { 0xF0, 0x48, 0xFF, 0x05 };
+    emettre(tc, lock_inc, sizeof(lock_inc));
+    emettre_rel32(tc, compteur, 4);
+}
+
+/* Ecrit dans le journal circulaire : numero, rdi, rsi, rdx, rcx, r8, r9
+ * et rax, sans toucher aux autres registres ni aux drapeaux. */
+static void generer_journal(struct tampon_code *tc, struct debogueur *dbg,
+                            int numero, unsigned long compteur)
+{
+    static const unsigned char entree[] = {
+        0x50,                         /* push rax */
+        0x53,                         /* push rbx */
+        0xB8, 0x01, 0x00, 0x00, 0x00, /* mov eax, 1 */
+        0xF0, 0x48, 0x0F, 0xC1, 0x05  /* lock xadd [rip+d], rax */
+    };
+    static const unsigned char et = 0x25; /* and eax, imm32 */
+    static const unsigned char indexation[] = {
+        0xC1, 0xE0, 0x06, /* shl eax, 6 */
+        0x48, 0x8D, 0x1D  /* lea rbx, [rip+d] */
+    };
+    static const unsigned char ajout[] = {
+        0x48, 0x01, 0xC3,      /* add rbx, rax */
+        0x48, 0xC7, 0x03       /* mov qword [rbx], imm32 */
+    };
+    static const unsigned char registres[] = {
+        0x48, 0x89, 0x7B, 0x08,      /* mov [rbx+8], rdi */
+        0x48, 0x89, 0x73, 0x10,      /* mov [rbx+16], rsi */
+        0x48, 0x89, 0x53, 0x18,      /* mov [rbx+24], rdx */
+        0x48, 0x89, 0x4B, 0x20,      /* mov [rbx+32], rcx */
+        0x4C, 0x89, 0x43, 0x28,      /* mov [rbx+40], r8 */
+        0x4C, 0x89, 0x4B, 0x30,      /* mov [rbx+48], r9 */
+        0x48, 0x8B, 0x44, 0x24, 0x08, /* mov rax, [rsp+8] */
+        0x48, 0x89, 0x43, 0x38       /* mov [rbx+56], rax */
+    };
+    static const unsigned char sortie[] = { 0x5B, 0x58 }; /* pop rbx; rax */
+
+    emettre(tc, entree, sizeof(entree));
+    emettre_rel32(tc, dbg->zone_trace + ZONE_INDEX_JOURNAL, 4);
+    emettre(tc, &et, 1);
+    emettre_32(tc, NB_ENTREES_JOURNAL - 1);
+    emettre(tc, indexation, sizeof(indexation));
+    emettre_rel32(tc, dbg->zone_trace + ZONE_JOURNAL, 4);
+    emettre(tc, ajout, sizeof(ajout));
+    emettre_32(tc, numero);
+    emettre(tc, registres, sizeof(registres));
+    generer_comptage(tc, compteur);
+    emettre(tc, sortie, sizeof(sortie));
+}
+
+/* Emplacement i : trampoline i de la page de code et compteur i. Un
+ * emplacement libere par tdel est repris, sauf si le programme est arrete
+ * dans son ancien trampoline. */
+/* Un mot de la pile, de rsp au sommet de sa region, pointe-t-il dans
+ * [debut, fin) ? Une adresse de retour ou un contexte de signal peut y
+ * renvoyer. Dans le doute (pile illisible), la reponse est oui. */
+static int pile_pointe_vers(struct debogueur *dbg,
+                            const struct user_regs_struct *regs,
+                            unsigned long debut, unsigned long fin)
+{
+    unsigned long region_debut;
+    unsigned long region_fin;
+    if (!region_contenant(dbg, regs->rsp, &region_debut, &region_fin))
+        return 1;
+
+    unsigned long mots[TAILLE_PAGE / sizeof(unsigned long)];
+    unsigned long pos = regs->rsp & ~7UL;
+    while (pos < region_fin)
+    {
+        size_t taille = region_fin - pos;
+        if (taille > sizeof(mots))
+            taille = sizeof(mots);
+        if (!lire_memoire(dbg, pos, mots, taille))
+            return 1;
+        for (size_t i = 0; i < taille / sizeof(mots[0]); i++)
+        {
+            if (mots[i] >= debut && mots[i] < fin)
+                return 1;
+        }
+        pos += taille;
+    }
+    return 0;
+}
+
+/* Un emplacement libere n'est repris que si rien ne peut encore executer
+ * son ancien trampoline : pas de call deplace, rip ailleurs et aucune
+ * adresse de la pile qui y mene. */
+static int choisir_emplacement_trace(struct debogueur *dbg,
+                                     const struct user_regs_struct *regs)
+{
+    for (int i = 0; i < dbg->nb_points_trace; i++)
+    {
+        struct point_trace *tp = &dbg->points_trace[i];
+        unsigned long trampoline =
+            dbg->zone_trace + ZONE_CODE + i * TAILLE_MAX_TRAMPOLINE;
+        unsigned long fin = trampoline + TAILLE_MAX_TRAMPOLINE;
+        if (tp->taille_deplacee == 0 && !tp->appel
+            && (regs->rip < trampoline || regs->rip >= fin)
+            && !pile_pointe_vers(dbg, regs, trampoline, fin))
+            return i;
+    }
+    if (dbg->nb_points_trace < MAX_POINTS_TRACE)
+        return dbg->nb_points_trace;
+    return -1;
+}
+
+static int ajouter_point_trace(struct debogueur *dbg, unsigned long addr,
+                               int journal)
+{
+    if (addr == 0 || addr == (unsigned long)-1)
+    {
+        echouer(dbg, "Adresse invalide pour le point de trace\n");
+        return 0;
+    }
+    if (!allouer_zone_trace(dbg, addr))
+        return 0;
+    if (!distance_rel32(dbg->zone_trace, addr))
+    {
+        echouer(dbg, "Adresse trop éloignée de la zone de trace\n");
+        return 0;
+    }
+
+    unsigned char code[TAILLE_LECTURE_CODE];
+    if (!lire_memoire(dbg, addr, code, sizeof(code)))
+    {
+        echouer(dbg, "Lecture impossible à 0x%lx\n", addr);
+        return 0;
+    }
+
+    size_t taille = 0;
+    int appel = 0;
+    while (taille < TAILLE_SAUT)
+    {
+        struct instruction ins;
+        if (!decoder_instruction(code + taille, sizeof(code) - taille, &ins))
+        {
+            echouer(dbg, "Instruction non reconnue à 0x%lx\n", addr + taille);
+            return 0;
+        }
+        int reg = (ins.modrm >> 3) & 7;
+        if (ins.carte == 1
+            && (ins.opcode == 0xE8
+                || (ins.opcode == 0xFF && (reg == 2 || reg == 3))))
+            appel = 1;
+        taille += ins.longueur;
+    }
+    if (chevauche_point_arret(dbg, addr, taille)
+        || chevauche_point_trace(dbg, addr, taille))
+    {
+        echouer(dbg,
+                "Un point d'arrêt ou de trace occupe déjà cette zone\n");
+        return 0;
+    }
+
+    struct user_regs_struct regs = { 0 };
+    if (ptrace(PTRACE_GETREGS, dbg->pid_fils, NULL, &regs) != -1
+        && regs.rip > addr && regs.rip < addr + taille)
+    {
+        echouer(dbg,
+                "Le programme est arrêté au milieu de la zone à modifier\n");
+        return 0;
+    }
+
+    int indice = choisir_emplacement_trace(dbg, &regs);
+    if (indice < 0)
+    {
+        echouer(dbg, "Nombre maximum de points de trace atteint\n");
+        return 0;
+    }
+
+    int numero = ++dbg->prochain_numero_trace;
+    unsigned long compteur = dbg->zone_trace + ZONE_COMPTEURS + indice * 8;
+
+    static const unsigned char prologue[] = {
+        0x48, 0x8D, 0x64, 0x24, 0x80, /* lea rsp, [rsp-128] */
+        0x9C                          /* pushfq */
+    };
+    static const unsigned char epilogue[] = {
+        0x9D,                                    /* popfq */
+        0x48, 0x8D, 0xA4, 0x24, 0x80, 0x00, 0x00, 0x00 /* lea rsp, [rsp+128] */
+    };
+
+    struct tampon_code tc = { .taille = 0 };
+    tc.adresse = dbg->zone_trace + ZONE_CODE + indice * TAILLE_MAX_TRAMPOLINE;
+    emettre(&tc, prologue, sizeof(prologue));
+    if (journal)
+        generer_journal(&tc, dbg, numero, compteur);
+    else
+        generer_comptage(&tc, compteur);
+    emettre(&tc, epilogue, sizeof(epilogue));
+    if (!deplacer_instructions(&tc, code, addr, taille))
+    {
+        dbg->echec = 1;
+        return 0;
+    }
+    static const unsigned char jmp = 0xE9;
+    emettre(&tc, &jmp, 1);
+    emettre_rel32(&tc, addr + taille, 4);
+
+    long zero = 0;
+    if (!ecrire_memoire(dbg, compteur, &zero, sizeof(zero))
+        || !ecrire_memoire(dbg, tc.adresse, tc.octets, tc.taille))
+    {
+        echouer(dbg, "Écriture du trampoline impossible\n");
+        return 0;
+    }
+
+    unsigned char saut[TAILLE_MAX_TRAMPOLINE];
+    memset(saut, 0x90, taille);
+    saut[0] = 0xE9;
+    int32_t rel = (int32_t)(tc.adresse - (addr + TAILLE_SAUT));
+    memcpy(saut + 1, &rel, 4);
+    if (!ecrire_memoire(dbg, addr, saut, taille))
+    {
+        echouer(dbg, "Écriture du saut impossible\n");
+        return 0;
+    }
+
+    if (indice == dbg->nb_points_trace)
+        dbg->nb_points_trace++;
+    struct point_trace *tp = &dbg->points_trace[indice];
+    tp->numero = numero;
+    tp->adresse = addr;
+    tp->trampoline = tc.adresse;
+    tp->taille_deplacee = taille;
+    memcpy(tp->octets_originaux, code, taille);
+    tp->journal = journal;
+    tp->appel = appel;
+    return 1;
+}
+
+static void supprimer_point_trace(struct debogueur *dbg, int numero)
+{
+    for (int i = 0; i < dbg->nb_points_trace; i++)
+    {
+        struct point_trace *tp = &dbg->points_trace[i];
+        if (tp->numero != numero)
+            continue;
+
+        if (!ecrire_memoire(dbg, tp->adresse, tp->octets_originaux,
+                            tp->taille_deplacee))
+        {
+            echouer(dbg, "Restauration du point de trace impossible\n");
+            return;
+        }
+        /* Le trampoline et son compteur restent en place jusqu'a ce
+         * qu'un nouveau point de trace reprenne l'emplacement. */
+        tp->adresse = 0;
+        tp->taille_deplacee = 0;
+        printf("Point de trace %d désactivé\n", numero);
+        return;
+    }
+    echouer(dbg, "Point de trace %d non trouvé\n", numero);
+}
+
+static void afficher_points_trace(struct debogueur *dbg)
+{
+    for (int i = 0; i < dbg->nb_points_trace; i++)
+    {
+        struct point_trace *tp = &dbg->points_trace[i];
+        unsigned long compteur = 0;
+        if (!lire_memoire(dbg, dbg->zone_trace + ZONE_COMPTEURS + i * 8,
+                          &compteur, sizeof(compteur)))
+        {
+            echouer(dbg, "Lecture des compteurs impossible\n");
+            return;
+        }
+        if (tp->taille_deplacee)
+            printf("%d: 0x%lx %lu passages%s\n", tp->numero, tp->adresse,
+                   compteur, tp->journal ? " (registres)" : "");
+        else
+            printf("%d: désactivé %lu passages\n", tp->numero, compteur);
+    }
+}
+
+static void afficher_journal_trace(struct debogueur *dbg, unsigned long nombre)
+{
+    if (!dbg->zone_trace)
+    {
+        printf("Aucun point de trace\n");
+        return;
+    }
+
+    unsigned long total;
+    static unsigned long journal[NB_ENTREES_JOURNAL * TAILLE_ENTREE_JOURNAL
+                                 / 8];
+    if (!lire_memoire(dbg, dbg->zone_trace + ZONE_INDEX_JOURNAL, &total,
+                      sizeof(total))
+        || !lire_memoire(dbg, dbg->zone_trace + ZONE_JOURNAL, journal,
+                         sizeof(journal)))
+    {
+        echouer(dbg, "Lecture du journal impossible\n");
+        return;
+    }
+
+    if (nombre > NB_ENTREES_JOURNAL)
+        nombre = NB_ENTREES_JOURNAL;
+    if (nombre > total)
+        nombre = total;
+    for (unsigned long n = total - nombre; n < total; n++)
+    {
+        unsigned long *e = journal + (n % NB_ENTREES_JOURNAL) * 8;
+        printf("#%lu tp %lu rdi=0x%lx rsi=0x%lx rdx=0x%lx rcx=0x%lx "
+               "r8=0x%lx r9=0x%lx rax=0x%lx\n",
+               n, e[0], e[1], e[2], e[3], e[4], e[5], e[6], e[7]);
+    }
+}
+
+struct recherche
+{
+    unsigned char motif[TAILLE_MAX_MOTIF];
+    size_t taille;
+    int aligne; /* valeur 64 bits alignee sur 8 octets */
+    unsigned long nb_trouves;
+};
+
+static void signaler_correspondance(struct debogueur *dbg,
+                                    struct recherche *r, unsigned long addr)
+{
+    if (r->nb_trouves++ >= MAX_RESULTATS_RECHERCHE)
+        return;
+
+    unsigned long decalage;
+    const char *nom = symbole_contenant(dbg, addr, &decalage);
+    if (nom)
+        printf("0x%lx <%s+%lu>\n", addr, nom, decalage);
+    else
+        printf("0x%lx\n", addr);
+}
+
+/* Filtre les positions dont le premier et le dernier octet correspondent,
+ * puis confirme avec memcmp. */
+static size_t rechercher_sse2(struct debogueur *dbg, struct recherche *r,
+                              const unsigned char *donnees, size_t n,
+                              unsigned long base)
+{
+    size_t m = r->taille;
+    size_t i = 0;
+    __m128i premier = _mm_set1_epi8((char)r->motif[0]);
+    __m128i dernier = _mm_set1_epi8((char)r->motif[m - 1]);
+
+    for (; i + m - 1 + 16 <= n; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(donnees + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(donnees + i + m - 1));
+        unsigned masque = (unsigned)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(a, premier),
+                          _mm_cmpeq_epi8(b, dernier)));
+        while (masque)
+        {
+            size_t j = i + (size_t)__builtin_ctz(masque);
+            if (m <= 2 || memcmp(donnees + j + 1, r->motif + 1, m - 2) == 0)
+                signaler_correspondance(dbg, r, base + j);
+            masque &= masque - 1;
+        }
+    }
+    return i;
+}
+
+__attribute__((target("avx2"))) static size_t
+rechercher_avx2(struct debogueur *dbg, struct recherche *r,
+                const unsigned char *donnees, size_t n, unsigned long base)
+{
+    size_t m = r->taille;
+    size_t i = 0;
+    __m256i premier = _mm256_set1_epi8((char)r->motif[0]);
+    __m256i dernier = _mm256_set1_epi8((char)r->motif[m - 1]);
+
+    for (; i + m - 1 + 32 <= n; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(donnees + i));
+        __m256i b =
+            _mm256_loadu_si256((const __m256i *)(donnees + i + m - 1));
+        unsigned masque = (unsigned)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, premier),
+                             _mm256_cmpeq_epi8(b, dernier)));
+        while (masque)
+        {
+            size_t j = i + (size_t)__builtin_ctz(masque);
+            if (m <= 2 || memcmp(donnees + j + 1, r->motif + 1, m - 2) == 0)
+                signaler_correspondance(dbg, r, base + j);
+            masque &= masque - 1;
+        }
+    }
+    return i;
+}
+
+/* Valeurs 64 bits alignees : SSE2 n'a pas de comparaison sur 64 bits,
+ * on compare les deux moities de 32 bits. */
+static size_t rechercher_aligne_sse2(struct debogueur *dbg,
+                                     struct recherche *r,
+                                     const unsigned char *donnees, size_t n,
+                                     unsigned long base)
+{
+    long long valeur;
+    memcpy(&valeur, r->motif, 8);
+    __m128i v = _mm_set1_epi64x(valeur);
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(donnees + i));
+        unsigned masque = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi32(a, v));
+        if ((masque & 0x00FF) == 0x00FF)
+            signaler_correspondance(dbg, r, base + i);
+        if ((masque & 0xFF00) == 0xFF00)
+            signaler_correspondance(dbg, r, base + i + 8);
+    }
+    return i;
+}
+
+__attribute__((target("avx2"))) static size_t
+rechercher_aligne_avx2(struct debogueur *dbg, struct recherche *r,
+                       const unsigned char *donnees, size_t n,
+                       unsigned long base)
+{
+    long long valeur;
+    memcpy(&valeur, r->motif, 8);
+    __m256i v = _mm256_set1_epi64x(valeur);
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(donnees + i));
+        unsigned masque =
+            (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi64(a, v));
+        while (masque)
+        {
+            int bit = __builtin_ctz(masque);
+            signaler_correspondance(dbg, r, base + i + bit);
+            masque &= ~(0xFFu << bit);
+        }
+    }
+    return i;
+}
+
+static void rechercher_tampon(struct debogueur *dbg, struct recherche *r,
+                              const unsigned char *donnees, size_t n,
+                              unsigned long base)
+{
+    static int avx2 = -1;
+    if (avx2 == -1)
+        avx2 = __builtin_cpu_supports("avx2") != 0;
+
+    if (n < r->taille)
+        return;
+
+    size_t i;
+    if (r->aligne)
+    {
+        i = avx2 ? rechercher_aligne_avx2(dbg, r, donnees, n, base)
+                 : rechercher_aligne_sse2(dbg, r, donnees, n, base);
+        for (; i + 8 <= n; i += 8)
+        {
+            if (memcmp(donnees + i, r->motif, 8) == 0)
+                signaler_correspondance(dbg, r, base + i);
+        }
+        return;
+    }
+
+    i = avx2 ? rechercher_avx2(dbg, r, donnees, n, base)
+             : rechercher_sse2(dbg, r, donnees, n, base);
+    for (; i + r->taille <= n; i++)
+    {
+        if (memcmp(donnees + i, r->motif, r->taille) == 0)
+            signaler_correspondance(dbg, r, base + i);
+    }
+}
+
+/* Parcourt les regions lisibles de /proc/<pid>/maps par blocs, les blocs
+ * successifs se recouvrant de taille - 1 octets. */
+static void rechercher_memoire(struct debogueur *dbg, struct recherche *r,
+                               unsigned long debut, unsigned long fin)
+{
+    char chemin[64];
+    snprintf(chemin, sizeof(chemin), "/proc/%d/maps", (int)dbg->pid_fils);
+    FILE *maps = fopen(chemin, "r");
+    if (!maps)
+    {
+        echouer_systeme(dbg, "fopen maps");
+        return;
+    }
+
+    unsigned char *tampon = malloc(TAILLE_BLOC_RECHERCHE);
+    if (!tampon)
+    {
+        fclose(maps);
+        return;
+    }
+
+    size_t recouvrement = r->aligne ? 0 : r->taille - 1;
+    char ligne[512];
+    while (fgets(ligne, sizeof(ligne), maps))
+    {
+        unsigned long region_debut;
+        unsigned long region_fin;
+        char droits[5];
+        if (sscanf(ligne, "%lx-%lx %4s", &region_debut, &region_fin, droits)
+                != 3
+            || droits[0] != 'r' || strstr(ligne, "[vvar]"))
+            continue;
+        if (region_debut < debut)
+            region_debut = debut;
+        if (region_fin > fin)
+            region_fin = fin;
+        if (r->aligne)
+            region_debut = (region_debut + 7) & ~7UL;
+
+        unsigned long pos = region_debut;
+        while (pos < region_fin && pos + r->taille <= region_fin)
+        {
+            size_t n = region_fin - pos;
+            if (n > TAILLE_BLOC_RECHERCHE)
+                n = TAILLE_BLOC_RECHERCHE;
+            if (!lire_memoire(dbg, pos, tampon, n))
+                break;
+            rechercher_tampon(dbg, r, tampon, n, pos);
+            if (pos + n >= region_fin)
+                break;
+            pos += n - recouvrement;
+        }
+    }
+
+    if (r->nb_trouves > MAX_RESULTATS_RECHERCHE)
+        printf("... %lu résultats non affichés\n",
+               r->nb_trouves - MAX_RESULTATS_RECHERCHE);
+    printf("%lu résultat(s)\n", r->nb_trouves);
+    free(tampon);
+    fclose(maps);
+}
+
+static int valeur_hexa(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static int analyser_motif(struct debogueur *dbg, const char *type,
+                          const char *texte, struct recherche *r)
+{
+    memset(r, 0, sizeof(*r));
+    if (strcmp(type, "str") == 0)
+    {
+        r->taille = strlen(texte);
+        if (r->taille == 0 || r->taille > TAILLE_MAX_MOTIF)
+            return 0;
+        memcpy(r->motif, texte, r->taille);
+        return 1;
+    }
+    if (strcmp(type, "hex") == 0)
+    {
+        if (texte[0] == '0' && (texte[1] == 'x' || texte[1] == 'X'))
+            texte += 2;
+        size_t longueur = strlen(texte);
+        if (longueur == 0 || longueur % 2 || longueur / 2 > TAILLE_MAX_MOTIF)
+            return 0;
+        for (size_t i = 0; i < longueur; i += 2)
+        {
+            int haut = valeur_hexa(texte[i]);
+            int bas = valeur_hexa(texte[i + 1]);
+            if (haut < 0 || bas < 0)
+                return 0;
+            r->motif[r->taille++] = (unsigned char)(haut << 4 | bas);
+        }
+        return 1;
+    }
+    if (strcmp(type, "ptr") == 0)
+    {
+        char *endptr;
+        unsigned long valeur = strtoul(texte, &endptr, 0);
+        if (*endptr != '\0')
+        {
+            valeur = recuperer_adresse_symbole(dbg, texte);
+            if (valeur == (unsigned long)-1)
+                return 0;
+        }
+        memcpy(r->motif, &valeur, 8);
+        r->taille = 8;
+        r->aligne = 1;
+        return 1;
+    }
+    return 0;
+}
+
+static uint64_t empreinte_page(const unsigned char *page)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < TAILLE_PAGE; i += 8)
+    {
+        uint64_t mot;
+        memcpy(&mot, page + i, 8);
+        h = (h ^ mot) * 0x100000001b3ULL;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+static void liberer_instantane(struct instantane *inst)
+{
+    for (size_t i = 0; i < inst->nb_regions; i++)
+    {
+        free(inst->regions[i].copie);
+        free(inst->regions[i].empreintes);
+    }
+    free(inst->regions);
+    memset(inst, 0, sizeof(*inst));
+}
+
+/* Remet a zero les bits soft-dirty de toutes les pages du fils. */
+static int effacer_soft_dirty(struct debogueur *dbg)
+{
+    char chemin[64];
+    snprintf(chemin, sizeof(chemin), "/proc/%d/clear_refs",
+             (int)dbg->pid_fils);
+    int fd = open(chemin, O_WRONLY);
+    if (fd == -1)
+        return 0;
+    int ok = write(fd, "4", 1) == 1;
+    close(fd);
+    return ok;
+}
+
+/* Un noyau sans CONFIG_MEM_SOFT_DIRTY accepte l'ecriture dans clear_refs
+ * mais ne positionne jamais le bit : on reecrit un octet a l'identique et
+ * on verifie que sa page devient soft-dirty. */
+static int verifier_soft_dirty(struct debogueur *dbg, unsigned long addr)
+{
+    unsigned char octet;
+    if (!lire_memoire(dbg, addr, &octet, 1)
+        || !ecrire_memoire(dbg, addr, &octet, 1))
+        return 0;
+
+    char chemin[64];
+    snprintf(chemin, sizeof(chemin), "/proc/%d/pagemap", (int)dbg->pid_fils);
+    int fd = open(chemin, O_RDONLY);
+    if (fd == -1)
+        return 0;
+    uint64_t entree = 0;
+    ssize_t lu = pread(fd, &entree, sizeof(entree),
+                       (off_t)(addr / TAILLE_PAGE * sizeof(entree)));
+    close(fd);
+    return lu == sizeof(entree) && (entree & BIT_SOFT_DIRTY);
+}
+
+static int ajouter_region_instantane(struct debogueur *dbg,
+                                     struct instantane *inst,
+                                     unsigned long debut, unsigned long fin)
+{
+    size_t nb_pages = (fin - debut) / TAILLE_PAGE;
+    struct region_instantane *regions = realloc(
+        inst->regions, (inst->nb_regions + 1) * sizeof(*inst->regions));
+    if (!regions)
+        return 0;
+    inst->regions = regions;
+
+    struct region_instantane *reg = &inst->regions[inst->nb_regions];
+    reg->debut = debut;
+    reg->fin = fin;
+    reg->copie = malloc(fin - debut);
+    reg->empreintes = malloc(nb_pages * sizeof(uint64_t));
+    if (!reg->copie || !reg->empreintes
+        || !lire_memoire(dbg, debut, reg->copie, fin - debut))
+    {
+        free(reg->copie);
+        free(reg->empreintes);
+        return 0;
+    }
+    for (size_t p = 0; p < nb_pages; p++)
+        reg->empreintes[p] = empreinte_page(reg->copie + p * TAILLE_PAGE);
+    inst->nb_regions++;
+    return 1;
+}
+
+static void prendre_instantane(struct debogueur *dbg, unsigned long debut,
+                               unsigned long fin)
+{
+    struct instantane *inst = &dbg->instantane;
+    liberer_instantane(inst);
+
+    char chemin[64];
+    snprintf(chemin, sizeof(chemin), "/proc/%d/maps", (int)dbg->pid_fils);
+    FILE *maps = fopen(chemin, "r");
+    if (!maps)
+    {
+        echouer_systeme(dbg, "fopen maps");
+        return;
+    }
+
+    inst->suivi_pages = effacer_soft_dirty(dbg);
+
+    size_t total = 0;
+    char ligne[512];
+    while (fgets(ligne, sizeof(ligne), maps))
+    {
+        unsigned long region_debut;
+        unsigned long region_fin;
+        char droits[5];
+        if (sscanf(ligne, "%lx-%lx %4s", &region_debut, &region_fin, droits)
+                != 3
+            || droits[0] != 'r' || droits[1] != 'w')
+            continue;
+        if (region_debut < debut)
+            region_debut = debut & ~(TAILLE_PAGE - 1);
+        if (region_fin > fin)
+            region_fin = (fin + TAILLE_PAGE - 1) & ~(TAILLE_PAGE - 1);
+        if (region_debut >= region_fin)
+            continue;
+        if (ajouter_region_instantane(dbg, inst, region_debut, region_fin))
+            total += region_fin - region_debut;
     }
+    fclose(maps);
+    if (inst->suivi_pages
+        && (inst->nb_regions == 0
+            || !verifier_soft_dirty(dbg, inst->regions[0].debut)))
+        inst->suivi_pages = 0;
+    if (!inst->suivi_pages)
+        printf("soft-dirty indisponible, toutes les pages seront relues\n");
+    inst->actif = 1;
+    printf("Instantané de %zu région(s), %zu octets\n", inst->nb_regions,
+           total);
+}
+
+static void afficher_plage_modifiee(struct debogueur *dbg,
+                                    unsigned long debut, unsigned long fin)
+{
+    unsigned long decalage;
+    const char *nom = symbole_contenant(dbg, debut, &decalage);
+    printf("0x%lx-0x%lx (%lu octets)", debut, fin, fin - debut);
+    if (nom)
+        printf(" <%s+%lu>", nom, decalage);
     printf("\n");
+}
 
-    while (rbp)
+/* Compare les pages marquees soft-dirty dans /proc/<pid>/pagemap avec
+ * l'instantane : l'empreinte ecarte les pages reecrites a l'identique,
+ * puis la copie donne les plages exactes. */
+static void comparer_instantane(struct debogueur *dbg)
+{
+    struct instantane *inst = &dbg->instantane;
+    if (!inst->actif)
     {
-        errno = 0;
-        unsigned long adr_retour = ptrace(PTRACE_PEEKDATA, dbg->pid_fils, rbp + 8, NULL);
-        if (errno != 0)
-            break;
+        echouer(dbg, "Aucun instantané\n");
+        return;
+    }
 
-        errno = 0;
-        unsigned long rbp_suivant = ptrace(PTRACE_PEEKDATA, dbg->pid_fils, rbp, NULL);
-        if (errno != 0)
-            break;
+    int fd_pagemap = -1;
+    if (inst->suivi_pages)
+    {
+        char chemin[64];
+        snprintf(chemin, sizeof(chemin), "/proc/%d/pagemap",
+                 (int)dbg->pid_fils);
+        fd_pagemap = open(chemin, O_RDONLY);
+    }
 
-        niveau++;
-        printf("#%d  0x%lx", niveau, adr_retour);
+    unsigned char page[TAILLE_PAGE];
+    size_t nb_pages_relues = 0;
+    size_t nb_plages = 0;
+    for (size_t r = 0; r < inst->nb_regions; r++)
+    {
+        struct region_instantane *reg = &inst->regions[r];
+        size_t nb_pages = (reg->fin - reg->debut) / TAILLE_PAGE;
+        uint64_t *entrees = NULL;
+        if (fd_pagemap != -1)
+        {
+            entrees = malloc(nb_pages * sizeof(uint64_t));
+            off_t pos = (off_t)(reg->debut / TAILLE_PAGE * sizeof(uint64_t));
+            if (entrees
+                && pread(fd_pagemap, entrees, nb_pages * sizeof(uint64_t), pos)
+                    != (ssize_t)(nb_pages * sizeof(uint64_t)))
+            {
+                free(entrees);
+                entrees = NULL;
+            }
+        }
 
-        for (size_t i = 0; i < dbg->elf.nb_symboles; i++)
+        unsigned long plage_debut = 0;
+        unsigned long plage_fin = 0;
+        for (size_t p = 0; p < nb_pages; p++)
         {
-            if (ELF64_ST_TYPE(dbg->elf.symboles[i].st_info) == STT_FUNC)
+            if (entrees && !(entrees[p] & BIT_SOFT_DIRTY))
+                continue;
+
+            unsigned long adresse = reg->debut + p * TAILLE_PAGE;
+            if (!lire_memoire(dbg, adresse, page, TAILLE_PAGE))
+                break;
+            nb_pages_relues++;
+            if (empreinte_page(page) == reg->empreintes[p])
+                continue;
+
+            const unsigned char *ancienne = reg->copie + p * TAILLE_PAGE;
+            for (size_t i = 0; i < TAILLE_PAGE; i++)
             {
-                unsigned long debut = dbg->elf.symboles[i].st_value;
-                unsigned long fin = debut + dbg->elf.symboles[i].st_size;
-                if (adr_retour >= debut && adr_retour < fin)
+                if (page[i] == ancienne[i])
+                    continue;
+                if (plage_fin == adresse + i)
                 {
-                    printf(" dans %s", dbg->elf.table_symboles + dbg->elf.symboles[i].st_name);
-                    break;
+                    plage_fin++;
+                    continue;
+                }
+                if (plage_fin)
+                {
+                    afficher_plage_modifiee(dbg, plage_debut, plage_fin);
+                    nb_plages++;
                 }
+                plage_debut = adresse + i;
+                plage_fin = plage_debut + 1;
             }
         }
-        printf("\n");
-
-        if (rbp_suivant <= rbp)
-            break;
-        rbp = rbp_suivant;
+        if (plage_fin)
+        {
+            afficher_plage_modifiee(dbg, plage_debut, plage_fin);
+            nb_plages++;
+        }
+        free(entrees);
     }
+
+    if (fd_pagemap != -1)
+        close(fd_pagemap);
+    printf("%zu plage(s) modifiée(s), %zu page(s) relue(s)\n", nb_plages,
+           nb_pages_relues);
 }
 
-void traiter_commande(struct debogueur *dbg, char *cmd)
+/* Adresse numerique ou symbole de fonction ; affiche l'erreur et retourne
+ * -1 si aucun ne convient. */
+static unsigned long analyser_adresse(struct debogueur *dbg, const char *texte)
 {
-    cmd[strcspn(cmd, "\n")] = 0;
-    char *token = strtok(cmd, " ");
-    if (!token)
-        return;
-
-    if (strcmp(token, "quit") == 0 || strcmp(token, "q") == 0 )
-    {
-        kill(dbg->pid_fils, SIGKILL);
-        exit(0);
-    }
-    else if (strcmp(token, "registers") == 0 || strcmp(token, "r") == 0)
+    char *endptr;
+    unsigned long addr = strtoul(texte, &endptr, 0);
+    if (*endptr != '\0')
     {
-        afficher_registres(dbg->pid_fils);
+        addr = recuperer_adresse_symbole(dbg, texte);
+        if (addr == (unsigned long)-1)
+            echouer(dbg, "Adresse ou symbole invalide\n");
     }
-    else if (strcmp(token, "continue") == 0 || strcmp(token, "c") == 0)
-    {
+    return addr;
+}
+
+static void commande_quitter(struct debogueur *dbg, int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    kill(dbg->pid_fils, SIGKILL);
+    exit(code_sortie(dbg));
+}
+
+static void commande_registres(struct debogueur *dbg, int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    afficher_registres(dbg->pid_fils);
+}
+
+static void commande_continuer(struct debogueur *dbg, int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    /* Dans une liste de commandes, la reprise est automatique. */
+    if (!dbg->dans_commandes)
         continuer_execution(dbg);
-    }
-    else if (strcmp(token, "next") == 0 || strcmp(token, "n") == 0)
+}
+
+static void commande_suivant(struct debogueur *dbg, int argc, char **argv)
+{
+    int nombre_pas = 1;
+    if (argc > 1)
+        nombre_pas = atoi(argv[1]);
+    etape_suivante(dbg, nombre_pas);
+}
+
+static void commande_tuer(struct debogueur *dbg, int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    kill(dbg->pid_fils, SIGKILL);
+    printf("Programme tué\n");
+}
+
+static void commande_memoire(struct debogueur *dbg, int argc, char **argv)
+{
+    char format = argv[0][0];
+    if (argc < 3)
     {
-        token = strtok(NULL, " ");
-        int nombre_pas = 1;
-        if (token)
-        {
-            nombre_pas = atoi(token);
-        }
-        etape_suivante(dbg, nombre_pas);
+        echouer(dbg, "Usage: %c <count> <addr>\n", format);
+        return;
     }
-    else if (strcmp(token, "kill") == 0 || strcmp(token, "k") == 0)
+    int count = atoi(argv[1]);
+    unsigned long addr = analyser_adresse(dbg, argv[2]);
+    if (addr == (unsigned long)-1)
+        return;
+    afficher_memoire(dbg, addr, count, format);
+}
+
+static void commande_point_arret(struct debogueur *dbg, int argc, char **argv)
+{
+    if (argc < 2)
     {
-        kill(dbg->pid_fils, SIGKILL);
-        printf("Programme tué\n");
+        echouer(dbg, "Usage: break <addr|symbol|fichier:ligne>\n");
+        return;
     }
-    else if (strcmp(token, "x") == 0 || strcmp(token, "d") == 0
-             || strcmp(token, "u") == 0)
+
+    unsigned long addr;
+    /* Le "::" d'un nom qualifie n'introduit pas un numero de ligne. */
+    const char *deux_points = strrchr(argv[1], ':');
+    if (deux_points && deux_points != argv[1] && deux_points[-1] != ':')
     {
-        char format = token[0];
-        token = strtok(NULL, " ");
-        if (!token)
+        char fichier[TAILLE_MAX_CMD];
+        snprintf(fichier, sizeof(fichier), "%.*s",
+                 (int)(deux_points - argv[1]), argv[1]);
+        char *fin;
+        errno = 0;
+        unsigned long ligne = strtoul(deux_points + 1, &fin, 10);
+        if (fin == deux_points + 1 || *fin != '\0' || errno != 0
+            || ligne == 0 || ligne > UINT_MAX)
         {
-            printf("Usage: %c <count> <addr>\n", format);
+            echouer(dbg, "Numéro de ligne invalide: %s\n", deux_points + 1);
             return;
         }
-        int count = atoi(token);
-        token = strtok(NULL, " ");
-        if (!token)
+        addr = adresse_fichier_ligne(dbg, fichier, (unsigned)ligne);
+        if (addr == (unsigned long)-1)
         {
-            printf("Usage: %c <count> <addr>\n", format);
+            echouer(dbg, "Aucun code pour %s:%s\n", fichier, deux_points + 1);
             return;
         }
+    }
+    else
+    {
+        addr = analyser_adresse(dbg, argv[1]);
+        if (addr == (unsigned long)-1)
+            return;
+    }
+    if (ajouter_point_arret(dbg, addr))
+    {
+        printf("Point d'arrêt ajouté à 0x%lx\n", addr);
+    }
+}
 
-        unsigned long addr;
-        char *endptr;
-        addr = strtoul(token, &endptr, 0);
-        if (*endptr != '\0')
+static void commande_pas(struct debogueur *dbg, int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    pas_source(dbg);
+}
+
+static void commande_back_trace(struct debogueur *dbg, int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    afficher_back_trace(dbg);
+}
+
+static void commande_blist(struct debogueur *dbg, int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    for (int i = 0; i < dbg->nb_points_arret; i++)
+    {
+        printf("%d: 0x%lx", dbg->points_arret[i].numero,
+               dbg->points_arret[i].adresse);
+        if (dbg->points_arret[i].nb_commandes)
+            printf(" (%d commandes)", dbg->points_arret[i].nb_commandes);
+        printf("\n");
+    }
+}
+
+static void liberer_commandes(struct point_arret *bp)
+{
+    for (int i = 0; i < bp->nb_commandes; i++)
+        free(bp->commandes[i]);
+    free(bp->commandes);
+    bp->commandes = NULL;
+    bp->nb_commandes = 0;
+}
+
+static void commande_bdel(struct debogueur *dbg, int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        echouer(dbg, "Usage: bdel <numero>\n");
+        return;
+    }
+    if (dbg->dans_commandes)
+    {
+        echouer(dbg, "bdel impossible dans une liste de commandes\n");
+        return;
+    }
+    int num = atoi(argv[1]);
+    for (int i = 0; i < dbg->nb_points_arret; i++)
+    {
+        if (dbg->points_arret[i].numero == num)
         {
-            addr = recuperer_adresse_symbole(dbg, token);
-            if (addr == (unsigned long)-1)
+            restaurer_point_arret(dbg, &dbg->points_arret[i]);
+            liberer_commandes(&dbg->points_arret[i]);
+            for (int j = i; j < dbg->nb_points_arret - 1; j++)
             {
-                printf("Adresse ou symbole invalide\n");
-                return;
+                dbg->points_arret[j] = dbg->points_arret[j + 1];
             }
+            dbg->nb_points_arret--;
+            printf("Point d'arrêt %d supprimé\n", num);
+            return;
         }
-        afficher_memoire(dbg, addr, count, format);
     }
-    else if (strcmp(token, "break") == 0 || strcmp(token, "b") == 0)
+    echouer(dbg, "Point d'arrêt %d non trouvé\n", num);
+}
+
+static void commande_trace(struct debogueur *dbg, int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        echouer(dbg, "Usage: trace <addr|symbol> [regs]\n");
+        return;
+    }
+
+    unsigned long addr = analyser_adresse(dbg, argv[1]);
+    if (addr == (unsigned long)-1)
+        return;
+    int journal = argc > 2 && strcmp(argv[2], "regs") == 0;
+    if (ajouter_point_trace(dbg, addr, journal))
+    {
+        printf("Point de trace %d ajouté à 0x%lx\n",
+               dbg->prochain_numero_trace, addr);
+    }
+}
+
+static void commande_tlist(struct debogueur *dbg, int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    afficher_points_trace(dbg);
+}
+
+static void commande_tlog(struct debogueur *dbg, int argc, char **argv)
+{
+    unsigned long nombre = 16;
+    if (argc > 1)
+        nombre = strtoul(argv[1], NULL, 0);
+    afficher_journal_trace(dbg, nombre);
+}
+
+static void commande_tdel(struct debogueur *dbg, int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        echouer(dbg, "Usage: tdel <numero>\n");
+        return;
+    }
+    supprimer_point_trace(dbg, atoi(argv[1]));
+}
+
+/* Plage optionnelle [debut fin] a partir de argv[premier]. */
+static int analyser_plage(int argc, char **argv, int premier,
+                          unsigned long *debut, unsigned long *fin)
+{
+    *debut = 0;
+    *fin = (unsigned long)-1;
+    if (argc <= premier)
+        return 1;
+    if (argc < premier + 2)
+        return 0;
+    *debut = strtoul(argv[premier], NULL, 0);
+    *fin = strtoul(argv[premier + 1], NULL, 0);
+    return 1;
+}
+
+static void commande_find(struct debogueur *dbg, int argc, char **argv)
+{
+    struct recherche r;
+    unsigned long debut;
+    unsigned long fin;
+    if (argc < 3 || !analyser_motif(dbg, argv[1], argv[2], &r)
+        || !analyser_plage(argc, argv, 3, &debut, &fin))
+    {
+        echouer(dbg, "Usage: find <str|hex|ptr> <motif> [debut fin]\n");
+        return;
+    }
+    rechercher_memoire(dbg, &r, debut, fin);
+}
+
+static void commande_snapshot(struct debogueur *dbg, int argc, char **argv)
+{
+    unsigned long debut;
+    unsigned long fin;
+    if (!analyser_plage(argc, argv, 1, &debut, &fin))
+    {
+        echouer(dbg, "Usage: snapshot [debut fin]\n");
+        return;
+    }
+    prendre_instantane(dbg, debut, fin);
+}
+
+static void commande_diff(struct debogueur *dbg, int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    comparer_instantane(dbg);
+}
+
+static void commande_record(struct debogueur *dbg, int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "stop") == 0)
+    {
+        arreter_enregistrement(dbg);
+        printf("Enregistrement arrêté\n");
+    }
+    else if (argc > 1 && strcmp(argv[1], "info") == 0)
+        printf("%lu pas enregistrés, %zu octets\n",
+               dbg->enregistrement.nb_pas, dbg->enregistrement.taille);
+    else if (demarrer_enregistrement(dbg))
+        printf("Enregistrement démarré\n");
+}
+
+static void commande_reverse_stepi(struct debogueur *dbg, int argc,
+                                   char **argv)
+{
+    reculer(dbg, argc > 1 ? atoi(argv[1]) : 1);
+}
+
+static void commande_reverse_continue(struct debogueur *dbg, int argc,
+                                      char **argv)
+{
+    (void)argc;
+    (void)argv;
+    reculer_jusqu_au_point_arret(dbg);
+}
+
+static void commande_stop(struct debogueur *dbg, int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    dbg->arret_demande = 1;
+}
+
+static void commande_commands(struct debogueur *dbg, int argc, char **argv);
+
+/* Table de dispatch, parcourue une seule fois par ligne lue : les listes de
+ * commandes des points d'arret gardent le resultat de l'analyse. */
+static const struct commande table_commandes[] = {
+    { "quit", "q", commande_quitter },
+    { "registers", "r", commande_registres },
+    { "continue", "c", commande_continuer },
+    { "next", "n", commande_suivant },
+    { "kill", "k", commande_tuer },
+    { "x", NULL, commande_memoire },
+    { "d", NULL, commande_memoire },
+    { "u", NULL, commande_memoire },
+    { "break", "b", commande_point_arret },
+    { "step", "s", commande_pas },
+    { "bt", "backtrace", commande_back_trace },
+    { "blist", NULL, commande_blist },
+    { "bdel", NULL, commande_bdel },
+    { "commands", NULL, commande_commands },
+    { "stop", NULL, commande_stop },
+    { "trace", "t", commande_trace },
+    { "tlist", NULL, commande_tlist },
+    { "tlog", NULL, commande_tlog },
+    { "tdel", NULL, commande_tdel },
+    { "find", "f", commande_find },
+    { "snapshot", NULL, commande_snapshot },
+    { "diff", NULL, commande_diff },
+    { "record", NULL, commande_record },
+    { "reverse-stepi", "rsi", commande_reverse_stepi },
+    { "reverse-continue", "rc", commande_reverse_continue },
+};
+
+/* Decoupe la ligne en arguments et retrouve sa commande. Retourne 0 pour
+ * une ligne vide ou une commande inconnue. */
+static int analyser_commande(struct debogueur *dbg, const char *texte,
+                             struct commande_analysee *ca)
+{
+    snprintf(ca->ligne, sizeof(ca->ligne), "%s", texte);
+    ca->ligne[strcspn(ca->ligne, "\n")] = '\0';
+    ca->argc = 0;
+    ca->commande = NULL;
+
+    char *sauvegarde;
+    for (char *token = strtok_r(ca->ligne, " \t", &sauvegarde);
+         token && ca->argc < MAX_ARGUMENTS;
+         token = strtok_r(NULL, " \t", &sauvegarde))
+        ca->argv[ca->argc++] = token;
+    if (ca->argc == 0)
+        return 0;
+
+    for (size_t i = 0; i < sizeof(table_commandes) / sizeof(*table_commandes);
+         i++)
     {
-        token = strtok(NULL, " ");
-        if (!token)
+        const struct commande *c = &table_commandes[i];
+        if (strcmp(ca->argv[0], c->nom) == 0
+            || (c->alias && strcmp(ca->argv[0], c->alias) == 0))
         {
-            printf("Usage: break <addr|symbol>\n");
-            return;
+            ca->commande = c;
+            return 1;
         }
+    }
+    echouer(dbg, "Commande inconnue: %s\n", ca->argv[0]);
+    return 0;
+}
 
-        unsigned long addr;
-        char *endptr;
-        addr = strtoul(token, &endptr, 0);
-        if (*endptr != '\0')
+static void executer_commande(struct debogueur *dbg,
+                              struct commande_analysee *ca)
+{
+    ca->commande->fonction(dbg, ca->argc, ca->argv);
+}
+
+/* commands <numero> : lit les lignes suivantes jusqu'a end et les attache
+ * au point d'arret. */
+static void commande_commands(struct debogueur *dbg, int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        echouer(dbg, "Usage: commands <numero>\n");
+        return;
+    }
+    if (dbg->dans_commandes)
+    {
+        echouer(dbg, "commands impossible dans une liste de commandes\n");
+        return;
+    }
+
+    int num = atoi(argv[1]);
+    struct point_arret *bp = NULL;
+    for (int i = 0; i < dbg->nb_points_arret; i++)
+    {
+        if (dbg->points_arret[i].numero == num)
+            bp = &dbg->points_arret[i];
+    }
+
+    char ligne[TAILLE_MAX_CMD];
+    struct commande_analysee **commandes = NULL;
+    int nb = 0;
+    while (fgets(ligne, sizeof(ligne), dbg->entree))
+    {
+        char *debut = ligne + strspn(ligne, " \t");
+        if (strncmp(debut, "end", 3) == 0
+            && (debut[3] == '\0' || strchr(" \t\n", debut[3])))
+            break;
+
+        struct commande_analysee *ca = malloc(sizeof(*ca));
+        struct commande_analysee **plus =
+            realloc(commandes, (nb + 1) * sizeof(*commandes));
+        if (!ca || !plus)
         {
-            addr = recuperer_adresse_symbole(dbg, token);
-            if (addr == (unsigned long)-1)
-            {
-                printf("Adresse ou symbole invalide\n");
-                return;
-            }
+            free(ca);
+            continue;
         }
-        if (ajouter_point_arret(dbg, addr))
+        commandes = plus;
+        if (!analyser_commande(dbg, debut, ca))
         {
-            printf("Point d'arrêt ajouté à 0x%lx\n", addr);
+            free(ca);
+            continue;
         }
+        commandes[nb++] = ca;
     }
-    else if (strcmp(token, "bt") == 0 || strcmp(token, "backtrace") == 0)
-        afficher_back_trace(dbg);
-    else if (strcmp(token, "blist") == 0)
+
+    if (!bp)
     {
-        for (int i = 0; i < dbg->nb_points_arret; i++)
-        {
-            printf("%d: 0x%lx\n", dbg->points_arret[i].numero,
-                   dbg->points_arret[i].adresse);
-        }
+        echouer(dbg, "Point d'arrêt %d non trouvé\n", num);
+        for (int i = 0; i < nb; i++)
+            free(commandes[i]);
+        free(commandes);
+        return;
     }
-    else if (strcmp(token, "bdel") == 0)
+    liberer_commandes(bp);
+    bp->commandes = commandes;
+    bp->nb_commandes = nb;
+}
+
+/* Execute la liste du point d'arret touche. Retourne 1 si l'execution doit
+ * reprendre sans revenir a l'invite. */
+static int executer_commandes_point_arret(struct debogueur *dbg, int indice)
+{
+    struct point_arret *bp = &dbg->points_arret[indice];
+    if (bp->nb_commandes == 0)
+        return 0;
+
+    dbg->dans_commandes = 1;
+    dbg->arret_demande = 0;
+    for (int i = 0; i < bp->nb_commandes; i++)
+        executer_commande(dbg, bp->commandes[i]);
+    dbg->dans_commandes = 0;
+    return !dbg->arret_demande;
+}
+
+void traiter_commande(struct debogueur *dbg, char *cmd)
+{
+    struct commande_analysee ca;
+    if (analyser_commande(dbg, cmd, &ca))
+        executer_commande(dbg, &ca);
+}
+
+static void lire_commandes(struct debogueur *dbg, FILE *entree,
+                           int interactif)
+{
+    char cmd[TAILLE_MAX_CMD];
+    dbg->entree = entree;
+    while (1)
     {
-        token = strtok(NULL, " ");
-        if (!token)
+        if (interactif)
         {
-            printf("Usage: bdel <numero>\n");
-            return;
+            printf("> ");
+            fflush(stdout);
         }
-        int num = atoi(token);
-        for (int i = 0; i < dbg->nb_points_arret; i++)
+        if (!fgets(cmd, sizeof(cmd), entree))
         {
-            if (dbg->points_arret[i].numero == num)
-            {
-                restaurer_point_arret(dbg, &dbg->points_arret[i]);
-                for (int j = i; j < dbg->nb_points_arret - 1; j++)
-                {
-                    dbg->points_arret[j] = dbg->points_arret[j + 1];
-                }
-                dbg->nb_points_arret--;
-                printf("Point d'arrêt %d supprimé\n", num);
-                return;
-            }
+            break;
         }
-        printf("Point d'arrêt %d non trouvé\n", num);
+        traiter_commande(dbg, cmd);
     }
 }
 
-
-
 int main(int argc, char *argv[])
 {
-    if (argc != 2)
+    const char *programme = NULL;
+    const char *script = NULL;
+    int batch = 0;
+    int demangle = 0;
+    int erreur = 0;
+    for (int i = 1; i < argc && !erreur; i++)
+    {
+        if (strcmp(argv[i], "--batch") == 0)
+            batch = 1;
+        else if (strcmp(argv[i], "-C") == 0
+                 || strcmp(argv[i], "--demangle") == 0)
+            demangle = 1;
+        else if (strcmp(argv[i], "-x") == 0)
+        {
+            if (i + 1 < argc)
+                script = argv[++i];
+            else
+            {
+                fprintf(stderr, "Option -x : fichier de commandes manquant\n");
+                erreur = 1;
+            }
+        }
+        else if (!programme)
+            programme = argv[i];
+        else
+            erreur = 1;
+    }
+    if (erreur || !programme)
     {
-        fprintf(stderr, "Usage: %s <programme>\n", argv[0]);
+        fprintf(stderr,
+                "Usage: %s [--batch] [-C] [-x script] <programme>\n",
+                argv[0]);
         return 1;
     }
 
     struct debogueur dbg = { 0 };
 
-    if (access(argv[1], X_OK) == -1)
+    if (access(programme, X_OK) == -1)
     {
         fprintf(stderr, "Le fichier %s n'existe pas ou n'est pas exécutable\n",
-                argv[1]);
+                programme);
         return 1;
     }
 
-    if (!lire_fichier_elf(argv[1], &dbg.elf))
+    if (!lire_fichier_elf(programme, &dbg.elf))
     {
         fprintf(stderr, "Erreur lors de la lecture du fichier ELF\n");
         return 1;
     }
 
     dbg.nb_points_arret = 0;
+    dbg.fd_memoire = -1;
+    dbg.demangle = demangle;
+    dbg.mode_script = script || batch;
+    initialiser_table_noms(&dbg.noms);
 
     dbg.pid_fils = fork();
     if (dbg.pid_fils == 0)
@@ -607,7 +5202,7 @@ int main(int argc, char *argv[])
             perror("ptrace");
             exit(1);
         }
-        execl(argv[1], argv[1], NULL);
+        execl(programme, programme, NULL);
         perror("execl");
         exit(1);
     }
@@ -616,18 +5211,30 @@ int main(int argc, char *argv[])
     waitpid(dbg.pid_fils, &statut, 0);
     ptrace(PTRACE_SETOPTIONS, dbg.pid_fils, 0, PTRACE_O_EXITKILL);
 
-    char cmd[TAILLE_MAX_CMD];
-    while (1)
+    if (script)
     {
-        printf("> ");
-        fflush(stdout);
-        if (!fgets(cmd, sizeof(cmd), stdin))
+        FILE *fichier = fopen(script, "r");
+        if (!fichier)
         {
-            break;
+            perror(script);
+            return 1;
         }
-        traiter_commande(&dbg, cmd);
+        lire_commandes(&dbg, fichier, 0);
+        fclose(fichier);
     }
+    if (!batch)
+        lire_commandes(&dbg, stdin, 1);
+    else if (!script)
+        lire_commandes(&dbg, stdin, 0);
 
+    if (dbg.fd_memoire != -1)
+        close(dbg.fd_memoire);
+    liberer_instantane(&dbg.instantane);
+    arreter_enregistrement(&dbg);
+    liberer_lignes(&dbg.lignes);
+    for (int i = 0; i < dbg.nb_points_arret; i++)
+        liberer_commandes(&dbg.points_arret[i]);
+    liberer_table_noms(&dbg.noms);
     free(dbg.elf.debut);
-    return 0;
+    return code_sortie(&dbg);
 }
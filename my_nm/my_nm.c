@@ -1,10 +1,16 @@
 #include <elf.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include "../commun/demangleur.h"
+
+/* Taille des classements du rapport de taille sans --top. */
+#define TOP_DEFAUT 10
+
 struct DonneesElf
 {
     unsigned char *debut;
@@ -78,8 +84,9 @@ int initialiser_elf(struct DonneesElf *donnees)
     return 1;
 }
 
+/* noms : table de demanglage de la table de chaines, NULL sans -C. */
 void afficher_symbole(Elf64_Sym *sym, char *strtab, char *shstrtab,
-                      Elf64_Shdr *shdr)
+                      Elf64_Shdr *shdr, struct table_noms *noms)
 {
     printf("%016lx\t%lu\t", sym->st_value, sym->st_size);
 
@@ -117,16 +124,22 @@ void afficher_symbole(Elf64_Sym *sym, char *strtab, char *shstrtab,
 
     if (sym->st_shndx == SHN_UNDEF)
         printf("UND\t");
+    else if (sym->st_shndx == SHN_ABS)
+        printf("ABS\t");
+    else if (sym->st_shndx == SHN_COMMON)
+        printf("COM\t");
     else
         printf("%s\t", shstrtab + shdr[sym->st_shndx].sh_name);
 
-    if (sym->st_name)
+    if (sym->st_name && noms)
+        printf("%s", nom_demangle(noms, sym->st_name, strtab + sym->st_name));
+    else if (sym->st_name)
         printf("%s", strtab + sym->st_name);
 
     printf("\n");
 }
 
-void afficher_symboles(struct DonneesElf *donnees)
+void afficher_symboles(struct DonneesElf *donnees, int demangle)
 {
     for (size_t i = 0; i < donnees->entete->e_shnum; i++)
     {
@@ -143,6 +156,8 @@ void afficher_symboles(struct DonneesElf *donnees)
 			       .sh_offset);
             size_t nombre_symboles =
                 donnees->table_sections[i].sh_size / sizeof(Elf64_Sym);
+            struct table_noms noms;
+            initialiser_table_noms(&noms);
 
             for (size_t j = 0; j < nombre_symboles; j++)
             {
@@ -152,23 +167,570 @@ void afficher_symboles(struct DonneesElf *donnees)
                     continue;
 
                 afficher_symbole(sym, strtab, donnees->table_chaines,
-                                 donnees->table_sections);
+                                 donnees->table_sections,
+                                 demangle ? &noms : NULL);
             }
+
+            liberer_table_noms(&noms);
         }
     }
 }
 
+/* Rapport de taille (--size-report) : les symboles dimensionnes sont
+ * tries par adresse, puis une seule passe cumule st_size par section, par
+ * type et par prefixe, garde les plus gros et mesure l'espace entre
+ * symboles voisins. Les alias (meme adresse, meme taille) comptent une
+ * fois. */
+
+struct SymboleTaille
+{
+    Elf64_Addr adresse;
+    Elf64_Xword taille;
+    Elf64_Half section;
+    unsigned char info;
+    const char *nom;
+    const char *lisible;
+};
+
+struct Cumul
+{
+    const char *nom;
+    size_t octets;
+    size_t nombre;
+};
+
+struct TablePrefixes
+{
+    struct Cumul *cases;
+    size_t capacite;
+    size_t nb;
+    struct arene noms;
+};
+
+struct CumulSection
+{
+    const char *nom;
+    size_t octets;
+    size_t nombre;
+    Elf64_Xword taille;
+    size_t remplissage;
+    size_t trous;
+};
+
+/* Meilleurs elements par taille decroissante, bornes a max. */
+struct Classement
+{
+    struct SymboleTaille *elements;
+    size_t nb;
+    size_t max;
+};
+
+static const char *nom_type_rapport(int type)
+{
+    switch (type)
+    {
+    case STT_NOTYPE:
+        return "STT_NOTYPE";
+    case STT_OBJECT:
+        return "STT_OBJECT";
+    case STT_FUNC:
+        return "STT_FUNC";
+    case STT_TLS:
+        return "STT_TLS";
+    case STT_GNU_IFUNC:
+        return "STT_GNU_IFUNC";
+    default:
+        return "STT_UNKNOWN";
+    }
+}
+
+/* Espace de noms C++ : composant avant le premier "::" du nom qualifie
+ * qui precede la liste de parametres, le type de retour etant ignore
+ * ("std::string moteur::nommer<int>()" -> "moteur"). Pour un nom C, ce
+ * qui precede le premier '_' suivant les soulignes de tete :
+ * "mod05_init" -> "mod05". */
+static size_t chercher_prefixe(const char *nom, const char **debut)
+{
+    const char *composant = nom;
+    const char *prefixe = NULL;
+    size_t longueur_prefixe = 0;
+    int niveau = 0;
+    for (const char *c = nom; *c; c++)
+    {
+        /* Une parenthese ouvrante apres un nom ouvre les parametres ; en
+         * tete de composant, c'est "(anonymous namespace)". */
+        if (niveau == 0 && *c == '(' && c > composant)
+            break;
+        if (*c == '<' || *c == '(')
+            niveau++;
+        else if ((*c == '>' || *c == ')') && niveau > 0)
+            niveau--;
+        else if (niveau == 0 && *c == ' ')
+            composant = c + 1;
+        else if (niveau == 0 && c[0] == ':' && c[1] == ':' && c > composant
+                 && (!prefixe || prefixe < composant))
+        {
+            prefixe = composant;
+            longueur_prefixe = (size_t)(c - composant);
+        }
+    }
+    if (prefixe)
+    {
+        *debut = prefixe;
+        return longueur_prefixe;
+    }
+
+    const char *c = nom;
+    while (*c == '_')
+        c++;
+    size_t longueur = (size_t)(c - nom) + strcspn(c, "_.(<");
+    *debut = nom;
+    return longueur > (size_t)(c - nom) ? longueur : strlen(nom);
+}
+
+static int agrandir_prefixes(struct TablePrefixes *table)
+{
+    size_t capacite = table->capacite ? table->capacite * 2 : 256;
+    struct Cumul *cases = calloc(capacite, sizeof(struct Cumul));
+    if (!cases)
+        return 0;
+
+    for (size_t i = 0; i < table->capacite; i++)
+    {
+        if (!table->cases[i].nom)
+            continue;
+        uint32_t hachage = 2166136261u;
+        for (const char *c = table->cases[i].nom; *c; c++)
+            hachage = (hachage ^ (unsigned char)*c) * 16777619u;
+        size_t j = hachage & (capacite - 1);
+        while (cases[j].nom)
+            j = (j + 1) & (capacite - 1);
+        cases[j] = table->cases[i];
+    }
+
+    free(table->cases);
+    table->cases = cases;
+    table->capacite = capacite;
+    return 1;
+}
+
+static void cumuler_prefixe(struct TablePrefixes *table, const char *nom,
+                            Elf64_Xword taille)
+{
+    const char *debut;
+    size_t longueur = chercher_prefixe(nom, &debut);
+
+    if ((table->nb + 1) * 4 > table->capacite * 3 && !agrandir_prefixes(table))
+        return;
+
+    uint32_t hachage = 2166136261u;
+    for (size_t i = 0; i < longueur; i++)
+        hachage = (hachage ^ (unsigned char)debut[i]) * 16777619u;
+
+    size_t i = hachage & (table->capacite - 1);
+    while (table->cases[i].nom)
+    {
+        if (strncmp(table->cases[i].nom, debut, longueur) == 0
+            && table->cases[i].nom[longueur] == '\0')
+            break;
+        i = (i + 1) & (table->capacite - 1);
+    }
+
+    struct Cumul *cumul = &table->cases[i];
+    if (!cumul->nom)
+    {
+        char *copie = arene_allouer(&table->noms, longueur + 1);
+        if (!copie)
+            return;
+        memcpy(copie, debut, longueur);
+        copie[longueur] = '\0';
+        cumul->nom = copie;
+        table->nb++;
+    }
+    cumul->octets += taille;
+    cumul->nombre++;
+}
+
+static void classer(struct Classement *classement,
+                    const struct SymboleTaille *element)
+{
+    if (classement->nb == classement->max
+        && (classement->max == 0
+            || element->taille
+                <= classement->elements[classement->nb - 1].taille))
+        return;
+
+    size_t i = classement->nb < classement->max ? classement->nb++
+                                                : classement->nb - 1;
+    while (i > 0 && classement->elements[i - 1].taille < element->taille)
+    {
+        classement->elements[i] = classement->elements[i - 1];
+        i--;
+    }
+    classement->elements[i] = *element;
+}
+
+/* Parmi des alias, le symbole global passe en premier et les represente. */
+static int comparer_adresses(const void *a, const void *b)
+{
+    const struct SymboleTaille *x = a;
+    const struct SymboleTaille *y = b;
+    if (x->section != y->section)
+        return x->section < y->section ? -1 : 1;
+    if (x->adresse != y->adresse)
+        return x->adresse < y->adresse ? -1 : 1;
+    if (x->taille != y->taille)
+        return x->taille > y->taille ? -1 : 1;
+
+    int lien_x = ELF64_ST_BIND(x->info) == STB_GLOBAL ? 0
+        : ELF64_ST_BIND(x->info) == STB_WEAK          ? 1
+                                                      : 2;
+    int lien_y = ELF64_ST_BIND(y->info) == STB_GLOBAL ? 0
+        : ELF64_ST_BIND(y->info) == STB_WEAK          ? 1
+                                                      : 2;
+    if (lien_x != lien_y)
+        return lien_x - lien_y;
+    return strcmp(x->nom, y->nom);
+}
+
+static int comparer_cumuls(const void *a, const void *b)
+{
+    const struct Cumul *x = a;
+    const struct Cumul *y = b;
+    if (x->octets != y->octets)
+        return x->octets < y->octets ? 1 : -1;
+    return strcmp(x->nom, y->nom);
+}
+
+static int comparer_sections(const void *a, const void *b)
+{
+    const struct CumulSection *x = a;
+    const struct CumulSection *y = b;
+    if (x->octets != y->octets)
+        return x->octets < y->octets ? 1 : -1;
+    return strcmp(x->nom, y->nom);
+}
+
+/* Un ecart n'est que du remplissage s'il amene exactement a l'alignement
+ * naturel de l'adresse suivante (au plus 64 octets). */
+static int est_remplissage(Elf64_Addr fin, Elf64_Addr suivant)
+{
+    Elf64_Addr alignement = suivant & -suivant;
+    if (alignement == 0 || alignement > 64)
+        alignement = 64;
+    return suivant - fin < alignement
+        && ((fin + alignement - 1) & ~(alignement - 1)) == suivant;
+}
+
+static void noter_ecart(struct CumulSection *section, struct Classement *trous,
+                        Elf64_Half indice, Elf64_Addr fin, Elf64_Addr suivant,
+                        const char *precedent)
+{
+    if (est_remplissage(fin, suivant))
+    {
+        section->remplissage += suivant - fin;
+        return;
+    }
+
+    struct SymboleTaille trou = { fin, suivant - fin, indice, 0, precedent,
+                                  precedent };
+    section->trous += suivant - fin;
+    classer(trous, &trou);
+}
+
+struct Cumuls
+{
+    struct CumulSection *sections;
+    struct Cumul types[16];
+    struct TablePrefixes prefixes;
+    struct Classement plus_gros;
+    struct Classement trous;
+};
+
+/* octets : part du symbole non deja attribuee a un symbole qui le
+ * chevauche, pour que les cumuls d'une section ne depassent pas sa taille. */
+static void cumuler(struct Cumuls *cumuls, const struct SymboleTaille *sym,
+                    Elf64_Xword octets)
+{
+    cumuls->sections[sym->section].octets += octets;
+    cumuls->sections[sym->section].nombre++;
+    cumuls->types[ELF64_ST_TYPE(sym->info)].octets += octets;
+    cumuls->types[ELF64_ST_TYPE(sym->info)].nombre++;
+    cumuler_prefixe(&cumuls->prefixes, sym->lisible, octets);
+    classer(&cumuls->plus_gros, sym);
+}
+
+/* Passe unique sur les symboles tries, section par section ; chaque
+ * octet revient au premier symbole qui le couvre. */
+static void parcourir_symboles(struct DonneesElf *donnees,
+                               struct SymboleTaille *symboles, size_t nb,
+                               struct Cumuls *cumuls)
+{
+    qsort(symboles, nb, sizeof(struct SymboleTaille), comparer_adresses);
+
+    size_t i = 0;
+    while (i < nb)
+    {
+        Elf64_Half indice = symboles[i].section;
+        Elf64_Shdr *shdr = &donnees->table_sections[indice];
+        struct CumulSection *section = &cumuls->sections[indice];
+        Elf64_Addr fin = shdr->sh_addr;
+        const char *precedent = "(debut)";
+
+        /* Hors objet relogeable, un symbole TLS vaut un decalage dans le
+         * segment TLS et non une adresse de la section. */
+        int ecarts = !((shdr->sh_flags & SHF_TLS)
+                       && donnees->entete->e_type != ET_REL);
+
+        for (; i < nb && symboles[i].section == indice; i++)
+        {
+            struct SymboleTaille *sym = &symboles[i];
+            if (i > 0 && symboles[i - 1].section == indice
+                && symboles[i - 1].adresse == sym->adresse
+                && symboles[i - 1].taille == sym->taille)
+                continue;
+
+            if (!ecarts)
+            {
+                cumuler(cumuls, sym, sym->taille);
+                continue;
+            }
+
+            Elf64_Addr debut = sym->adresse > fin ? sym->adresse : fin;
+            Elf64_Addr fin_sym = sym->adresse + sym->taille;
+            cumuler(cumuls, sym, fin_sym > debut ? fin_sym - debut : 0);
+            if (sym->adresse > fin)
+                noter_ecart(section, &cumuls->trous, indice, fin,
+                            sym->adresse, precedent);
+            if (sym->adresse + sym->taille > fin)
+            {
+                fin = sym->adresse + sym->taille;
+                precedent = sym->nom;
+            }
+        }
+
+        if (ecarts && shdr->sh_addr + shdr->sh_size > fin)
+            noter_ecart(section, &cumuls->trous, indice, fin,
+                        shdr->sh_addr + shdr->sh_size, precedent);
+    }
+}
+
+static Elf64_Shdr *trouver_table_symboles(struct DonneesElf *donnees)
+{
+    Elf64_Shdr *dynamique = NULL;
+    for (size_t i = 0; i < donnees->entete->e_shnum; i++)
+    {
+        if (donnees->table_sections[i].sh_type == SHT_SYMTAB)
+            return &donnees->table_sections[i];
+        if (donnees->table_sections[i].sh_type == SHT_DYNSYM)
+            dynamique = &donnees->table_sections[i];
+    }
+    return dynamique;
+}
+
+static void afficher_rapport(struct DonneesElf *donnees,
+                             struct Cumuls *cumuls, size_t top)
+{
+    struct CumulSection *sections = cumuls->sections;
+    struct Cumul *types = cumuls->types;
+    struct TablePrefixes *prefixes = &cumuls->prefixes;
+    struct Classement *symboles = &cumuls->plus_gros;
+    struct Classement *trous = &cumuls->trous;
+    size_t nb_sections = donnees->entete->e_shnum;
+    struct CumulSection total = { "total", 0, 0, 0, 0, 0 };
+    for (size_t i = 0; i < nb_sections; i++)
+    {
+        total.octets += sections[i].octets;
+        total.nombre += sections[i].nombre;
+        total.remplissage += sections[i].remplissage;
+        total.trous += sections[i].trous;
+        if (sections[i].nombre)
+            total.taille += sections[i].taille;
+    }
+
+    printf("total\t%zu\t%zu\t%lu\t%zu\t%zu\n", total.octets, total.nombre,
+           total.taille, total.remplissage, total.trous);
+
+    qsort(sections, nb_sections, sizeof(struct CumulSection),
+          comparer_sections);
+    for (size_t i = 0; i < nb_sections && sections[i].nombre; i++)
+        printf("section\t%zu\t%zu\t%lu\t%zu\t%zu\t%s\n", sections[i].octets,
+               sections[i].nombre, sections[i].taille,
+               sections[i].remplissage, sections[i].trous, sections[i].nom);
+
+    qsort(types, 16, sizeof(struct Cumul), comparer_cumuls);
+    for (size_t i = 0; i < 16 && types[i].nombre; i++)
+        printf("type\t%zu\t%zu\t%s\n", types[i].octets, types[i].nombre,
+               types[i].nom);
+
+    size_t nb = 0;
+    for (size_t i = 0; i < prefixes->capacite; i++)
+        if (prefixes->cases[i].nom)
+            prefixes->cases[nb++] = prefixes->cases[i];
+    if (nb)
+        qsort(prefixes->cases, nb, sizeof(struct Cumul), comparer_cumuls);
+    for (size_t i = 0; i < nb && i < top; i++)
+        printf("prefixe\t%zu\t%zu\t%s\n", prefixes->cases[i].octets,
+               prefixes->cases[i].nombre, prefixes->cases[i].nom);
+
+    Elf64_Shdr *shdr = donnees->table_sections;
+    for (size_t i = 0; i < symboles->nb; i++)
+    {
+        struct SymboleTaille *s = &symboles->elements[i];
+        printf("symbole\t%lu\t%016lx\t%s\t%s\n", s->taille, s->adresse,
+               donnees->table_chaines + shdr[s->section].sh_name, s->nom);
+    }
+
+    for (size_t i = 0; i < trous->nb; i++)
+    {
+        struct SymboleTaille *t = &trous->elements[i];
+        printf("trou\t%lu\t%016lx\t%s\t%s\n", t->taille, t->adresse,
+               donnees->table_chaines + shdr[t->section].sh_name, t->nom);
+    }
+}
+
+int rapport_taille(struct DonneesElf *donnees, size_t top, int demangle)
+{
+    Elf64_Shdr *table = trouver_table_symboles(donnees);
+    if (!table)
+    {
+        fprintf(stderr, "Pas de table des symboles\n");
+        return 0;
+    }
+
+    Elf64_Sym *symboles = (Elf64_Sym *)(donnees->debut + table->sh_offset);
+    char *strtab = (char *)(donnees->debut
+                            + donnees->table_sections[table->sh_link]
+                                  .sh_offset);
+    size_t nombre_symboles = table->sh_size / sizeof(Elf64_Sym);
+    size_t nb_sections = donnees->entete->e_shnum;
+
+    /* top vaut 0 sans --top : les classements sont alors bornes par la
+     * table. Un --top plus grand que la table est refuse. */
+    if (top == 0)
+        top = nombre_symboles < TOP_DEFAUT ? nombre_symboles : TOP_DEFAUT;
+    else if (top > nombre_symboles)
+    {
+        fprintf(stderr, "--top %zu dépasse le nombre de symboles (%zu)\n", top,
+                nombre_symboles);
+        return 0;
+    }
+
+    struct Cumuls cumuls = { 0 };
+    cumuls.sections = calloc(nb_sections, sizeof(struct CumulSection));
+    cumuls.plus_gros.elements = malloc(top * sizeof(struct SymboleTaille) + 1);
+    cumuls.plus_gros.max = top;
+    cumuls.trous.elements = malloc(top * sizeof(struct SymboleTaille) + 1);
+    cumuls.trous.max = top;
+    struct SymboleTaille *tries =
+        malloc(nombre_symboles * sizeof(struct SymboleTaille) + 1);
+
+    int resultat = cumuls.sections && cumuls.plus_gros.elements
+        && cumuls.trous.elements && tries;
+    if (!resultat)
+        fprintf(stderr, "Mémoire insuffisante\n");
+
+    struct table_noms noms;
+    initialiser_table_noms(&noms);
+    size_t nb_tries = 0;
+
+    for (size_t j = 0; resultat && j < nombre_symboles; j++)
+    {
+        Elf64_Sym *sym = &symboles[j];
+        int type = ELF64_ST_TYPE(sym->st_info);
+        if (type == STT_FILE || type == STT_SECTION || sym->st_size == 0
+            || sym->st_shndx == SHN_UNDEF || sym->st_shndx >= SHN_LORESERVE
+            || sym->st_shndx >= nb_sections)
+            continue;
+
+        /* Le prefixe se lit sur le nom demangle, meme sans -C. */
+        const char *brut = strtab + sym->st_name;
+        const char *lisible = nom_demangle(&noms, sym->st_name, brut);
+        struct SymboleTaille entree = { sym->st_value, sym->st_size,
+                                        sym->st_shndx, sym->st_info,
+                                        demangle ? lisible : brut, lisible };
+        tries[nb_tries++] = entree;
+    }
+
+    if (resultat)
+    {
+        for (int i = 0; i < 16; i++)
+            cumuls.types[i].nom = nom_type_rapport(i);
+        for (size_t i = 0; i < nb_sections; i++)
+        {
+            cumuls.sections[i].nom =
+                donnees->table_chaines + donnees->table_sections[i].sh_name;
+            cumuls.sections[i].taille = donnees->table_sections[i].sh_size;
+        }
+
+        parcourir_symboles(donnees, tries, nb_tries, &cumuls);
+        afficher_rapport(donnees, &cumuls, top);
+    }
+
+    free(cumuls.prefixes.cases);
+    arene_liberer(&cumuls.prefixes.noms);
+    liberer_table_noms(&noms);
+    free(cumuls.sections);
+    free(cumuls.plus_gros.elements);
+    free(cumuls.trous.elements);
+    free(tries);
+    return resultat;
+}
+
+/* Entier decimal strictement positif, sans signe ni caractere en trop. */
+static int lire_top(const char *texte, size_t *top)
+{
+    char *fin;
+    if (*texte < '0' || *texte > '9')
+        return 0;
+    errno = 0;
+    unsigned long valeur = strtoul(texte, &fin, 10);
+    if (errno || *fin != '\0' || valeur == 0)
+        return 0;
+    *top = valeur;
+    return 1;
+}
+
 int main(int argc, char **argv)
 {
-    if (argc != 2)
+    int demangle = 0;
+    int rapport = 0;
+    size_t top = 0;
+    const char *chemin = NULL;
+
+    for (int i = 1; i < argc; i++)
     {
-        fprintf(stderr, "Usage: %s fichier\n", argv[0]);
+        if (strcmp(argv[i], "-C") == 0 || strcmp(argv[i], "--demangle") == 0)
+            demangle = 1;
+        else if (strcmp(argv[i], "--size-report") == 0)
+            rapport = 1;
+        else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc)
+        {
+            if (!lire_top(argv[++i], &top))
+            {
+                fprintf(stderr, "Valeur de --top invalide : %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (chemin == NULL)
+            chemin = argv[i];
+        else
+        {
+            chemin = NULL;
+            break;
+        }
+    }
+
+    if (chemin == NULL)
+    {
+        fprintf(stderr, "Usage: %s [-C] [--size-report [--top N]] fichier\n",
+                argv[0]);
         return 1;
     }
 
     struct DonneesElf donnees = { 0 };
 
-    if (!lire_fichier(argv[1], &donnees))
+    if (!lire_fichier(chemin, &donnees))
     {
         fprintf(stderr, "Erreur lors de la lecture du fichier\n");
         return 1;
@@ -181,7 +743,11 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    afficher_symboles(&donnees);
+    int statut = 0;
+    if (rapport)
+        statut = !rapport_taille(&donnees, top, demangle);
+    else
+        afficher_symboles(&donnees, demangle);
     free(donnees.debut);
-    return 0;
+    return statut;
 }